@@ -0,0 +1,313 @@
+#include <benchmark/benchmark.h>
+#include <ez/MemoryPool.hpp>
+#include <ez/ObjectPool.hpp>
+#include <ez/SizeClassPool.hpp>
+#include <algorithm>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <vector>
+
+// Compares the pools against new/delete and the standard pmr pool resources.
+// Every allocator is wrapped to the same alloc()/free() interface, payloads come in several sizes.
+
+namespace {
+	template<std::size_t Size>
+	struct Payload {
+		unsigned char bytes[Size];
+	};
+
+	template<typename T, std::size_t BlockSize>
+	struct EzPool {
+		ez::MemoryPool<T, BlockSize> pool;
+
+		T* alloc() {
+			return pool.alloc();
+		}
+		void free(T* obj) {
+			pool.free(obj);
+		}
+	};
+
+	template<typename T>
+	struct NewDelete {
+		T* alloc() {
+			return static_cast<T*>(::operator new(sizeof(T)));
+		}
+		void free(T* obj) {
+			::operator delete(obj);
+		}
+	};
+
+	template<typename T, typename Resource>
+	struct PmrPool {
+		Resource resource;
+
+		T* alloc() {
+			return static_cast<T*>(resource.allocate(sizeof(T), alignof(T)));
+		}
+		void free(T* obj) {
+			resource.deallocate(obj, sizeof(T), alignof(T));
+		}
+	};
+
+	template<typename T>
+	using UnsyncPmr = PmrPool<T, std::pmr::unsynchronized_pool_resource>;
+	template<typename T>
+	using SyncPmr = PmrPool<T, std::pmr::synchronized_pool_resource>;
+
+	enum Order {
+		Lifo,
+		Fifo,
+		Random
+	};
+
+	// Positions in which to free a batch of n allocations
+	std::vector<std::size_t> freeOrder(std::size_t n, Order order) {
+		std::vector<std::size_t> result(n);
+		for (std::size_t i = 0; i < n; ++i) {
+			result[i] = i;
+		}
+		if (order == Lifo) {
+			std::reverse(result.begin(), result.end());
+		}
+		else if (order == Random) {
+			std::shuffle(result.begin(), result.end(), std::mt19937_64{ 42 });
+		}
+		return result;
+	}
+}
+
+// Allocate a batch then free it in LIFO, FIFO or random order
+template<typename Allocator, typename T>
+static void churn(benchmark::State& state) {
+	std::size_t n = static_cast<std::size_t>(state.range(0));
+	std::vector<std::size_t> order = freeOrder(n, static_cast<Order>(state.range(1)));
+	std::vector<T*> ptrs(n);
+	Allocator allocator;
+
+	for (auto _ : state) {
+		for (T*& ptr : ptrs) {
+			ptr = allocator.alloc();
+		}
+		benchmark::ClobberMemory();
+		for (std::size_t index : order) {
+			allocator.free(ptrs[index]);
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(n));
+}
+
+#define EZ_CHURN_BENCHMARK(...) \
+	BENCHMARK_TEMPLATE(churn, __VA_ARGS__)->ArgNames({ "n", "order" })->ArgsProduct({ { 1 << 10, 1 << 16 }, { Lifo, Fifo, Random } })
+
+EZ_CHURN_BENCHMARK(EzPool<Payload<16>, 64>, Payload<16>);
+EZ_CHURN_BENCHMARK(EzPool<Payload<16>, 256>, Payload<16>);
+EZ_CHURN_BENCHMARK(EzPool<Payload<16>, 1024>, Payload<16>);
+EZ_CHURN_BENCHMARK(EzPool<Payload<64>, 256>, Payload<64>);
+EZ_CHURN_BENCHMARK(EzPool<Payload<256>, 64>, Payload<256>);
+EZ_CHURN_BENCHMARK(EzPool<Payload<256>, 256>, Payload<256>);
+EZ_CHURN_BENCHMARK(NewDelete<Payload<16>>, Payload<16>);
+EZ_CHURN_BENCHMARK(NewDelete<Payload<64>>, Payload<64>);
+EZ_CHURN_BENCHMARK(NewDelete<Payload<256>>, Payload<256>);
+EZ_CHURN_BENCHMARK(UnsyncPmr<Payload<16>>, Payload<16>);
+EZ_CHURN_BENCHMARK(UnsyncPmr<Payload<64>>, Payload<64>);
+EZ_CHURN_BENCHMARK(UnsyncPmr<Payload<256>>, Payload<256>);
+EZ_CHURN_BENCHMARK(SyncPmr<Payload<16>>, Payload<16>);
+EZ_CHURN_BENCHMARK(SyncPmr<Payload<64>>, Payload<64>);
+EZ_CHURN_BENCHMARK(SyncPmr<Payload<256>>, Payload<256>);
+
+// Allocate a batch with alloc_n then release it with a single free_n, the pointers in LIFO, FIFO or random order
+template<typename T, std::size_t BlockSize>
+static void churn_bulk(benchmark::State& state) {
+	std::size_t n = static_cast<std::size_t>(state.range(0));
+	std::vector<std::size_t> order = freeOrder(n, static_cast<Order>(state.range(1)));
+	std::vector<T*> ptrs(n), release(n);
+	ez::MemoryPool<T, BlockSize> pool;
+
+	for (auto _ : state) {
+		pool.alloc_n(ptrs.data(), n);
+		for (std::size_t i = 0; i < n; ++i) {
+			release[i] = ptrs[order[i]];
+		}
+		benchmark::ClobberMemory();
+		pool.free_n(release.data(), n);
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(n));
+}
+BENCHMARK_TEMPLATE(churn_bulk, Payload<16>, 256)->ArgNames({ "n", "order" })->ArgsProduct({ { 1 << 10, 1 << 16 }, { Lifo, Fifo, Random } });
+
+// Construct and destroy objects with a non-trivial constructor and destructor
+template<typename Allocator>
+static void create_destroy_string(benchmark::State& state) {
+	std::size_t n = static_cast<std::size_t>(state.range(0));
+	std::vector<std::string*> ptrs(n);
+	Allocator allocator;
+
+	for (auto _ : state) {
+		for (std::string*& ptr : ptrs) {
+			ptr = new (allocator.alloc()) std::string("a string long enough to need a heap allocation");
+		}
+		benchmark::ClobberMemory();
+		for (std::string* ptr : ptrs) {
+			ptr->~basic_string();
+			allocator.free(ptr);
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(n));
+}
+BENCHMARK_TEMPLATE(create_destroy_string, EzPool<std::string, 256>)->Arg(1 << 12);
+BENCHMARK_TEMPLATE(create_destroy_string, NewDelete<std::string>)->Arg(1 << 12);
+BENCHMARK_TEMPLATE(create_destroy_string, UnsyncPmr<std::string>)->Arg(1 << 12);
+BENCHMARK_TEMPLATE(create_destroy_string, SyncPmr<std::string>)->Arg(1 << 12);
+
+// Iterate a pool with the given percentage of slots in use, spread evenly over the blocks
+template<std::size_t BlockSize>
+static void iterate_occupancy(benchmark::State& state) {
+	ez::MemoryPool<std::uint64_t, BlockSize> pool;
+	std::vector<std::uint64_t*> ptrs;
+	const std::size_t total = std::size_t(1) << 18;
+	for (std::size_t i = 0; i < total; ++i) {
+		ptrs.push_back(pool.alloc());
+		*ptrs.back() = i;
+	}
+	std::size_t percent = static_cast<std::size_t>(state.range(0));
+	std::size_t live = 0;
+	for (std::size_t i = 0; i < total; ++i) {
+		if ((i * 37 % 100) >= percent) {
+			pool.free(ptrs[i]);
+		}
+		else {
+			++live;
+		}
+	}
+
+	for (auto _ : state) {
+		std::uint64_t sum = 0;
+		for (std::uint64_t val : pool) {
+			sum += val;
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(live));
+}
+BENCHMARK_TEMPLATE(iterate_occupancy, 64)->DenseRange(10, 100, 30);
+BENCHMARK_TEMPLATE(iterate_occupancy, 256)->DenseRange(10, 100, 30);
+BENCHMARK_TEMPLATE(iterate_occupancy, 1024)->DenseRange(10, 100, 30);
+
+// Look up objects of the pool through contains() and find(), with half the queries missing the pool
+template<bool Aligned>
+static void lookup(benchmark::State& state) {
+	ez::BasicMemoryPool<std::unordered_map, std::uint64_t, 256, Aligned> pool;
+	std::vector<std::uint64_t> outside(1024);
+	std::vector<const std::uint64_t*> queries;
+	for (int64_t i = 0; i < state.range(0); ++i) {
+		queries.push_back(pool.alloc());
+		queries.push_back(&outside[static_cast<std::size_t>(i) % outside.size()]);
+	}
+	std::shuffle(queries.begin(), queries.end(), std::mt19937_64{ 42 });
+
+	for (auto _ : state) {
+		std::size_t found = 0;
+		for (const std::uint64_t* ptr : queries) {
+			found += pool.contains(ptr);
+		}
+		benchmark::DoNotOptimize(found);
+		auto iter = pool.find(queries.front());
+		benchmark::DoNotOptimize(iter);
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(queries.size()));
+}
+BENCHMARK_TEMPLATE(lookup, false)->Range(1 << 10, 1 << 18);
+BENCHMARK_TEMPLATE(lookup, true)->Range(1 << 10, 1 << 18);
+
+// Reserve n objects up front, then release every block with shrink()
+template<std::size_t BlockSize>
+static void reserve_shrink(benchmark::State& state) {
+	for (auto _ : state) {
+		ez::MemoryPool<std::uint64_t, BlockSize> pool;
+		pool.reserve(static_cast<std::size_t>(state.range(0)));
+		benchmark::DoNotOptimize(pool.capacity());
+		pool.shrink();
+		benchmark::DoNotOptimize(pool.capacity());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(reserve_shrink, 64)->Range(1 << 10, 1 << 18);
+BENCHMARK_TEMPLATE(reserve_shrink, 256)->Range(1 << 10, 1 << 18);
+BENCHMARK_TEMPLATE(reserve_shrink, 1024)->Range(1 << 10, 1 << 18);
+
+// The same with blocks carved from chunks of up to 4096 blocks
+template<std::size_t BlockSize>
+static void reserve_shrink_chunked(benchmark::State& state) {
+	for (auto _ : state) {
+		ez::MemoryPool<std::uint64_t, BlockSize> pool;
+		pool.set_growth(1, 4096);
+		pool.reserve(static_cast<std::size_t>(state.range(0)));
+		benchmark::DoNotOptimize(pool.capacity());
+		pool.shrink();
+		benchmark::DoNotOptimize(pool.capacity());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(reserve_shrink_chunked, 64)->Range(1 << 10, 1 << 18);
+BENCHMARK_TEMPLATE(reserve_shrink_chunked, 256)->Range(1 << 10, 1 << 18);
+BENCHMARK_TEMPLATE(reserve_shrink_chunked, 1024)->Range(1 << 10, 1 << 18);
+
+// Grow a pool to 10M objects one allocation at a time, with and without chunks
+template<bool Chunked>
+static void grow_large(benchmark::State& state) {
+	for (auto _ : state) {
+		ez::MemoryPool<std::uint64_t> pool;
+		if constexpr (Chunked) {
+			pool.set_growth(1, 4096);
+		}
+		for (int64_t i = 0; i < state.range(0); ++i) {
+			*pool.alloc() = static_cast<std::uint64_t>(i);
+		}
+		benchmark::DoNotOptimize(pool.capacity());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(grow_large, false)->Arg(10000000)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(grow_large, true)->Arg(10000000)->Unit(benchmark::kMillisecond);
+
+// Allocate buffers of random sizes up to 512 bytes through a memory resource, then free them in random order
+template<typename Resource>
+static void variable_sizes(benchmark::State& state) {
+	std::size_t n = static_cast<std::size_t>(state.range(0));
+	std::mt19937_64 rng{ 42 };
+	std::vector<std::size_t> sizes(n);
+	for (std::size_t& size : sizes) {
+		size = 1 + rng() % 512;
+	}
+	std::vector<std::size_t> order = freeOrder(n, Random);
+	std::vector<void*> ptrs(n);
+	Resource resource;
+
+	for (auto _ : state) {
+		for (std::size_t i = 0; i < n; ++i) {
+			ptrs[i] = resource.allocate(sizes[i]);
+		}
+		benchmark::ClobberMemory();
+		for (std::size_t index : order) {
+			resource.deallocate(ptrs[index], sizes[index]);
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(n));
+}
+
+namespace {
+	// operator new and delete behind the memory resource interface
+	struct NewDeleteResource {
+		void* allocate(std::size_t bytes) {
+			return std::pmr::new_delete_resource()->allocate(bytes);
+		}
+		void deallocate(void* ptr, std::size_t bytes) {
+			std::pmr::new_delete_resource()->deallocate(ptr, bytes);
+		}
+	};
+}
+BENCHMARK_TEMPLATE(variable_sizes, ez::SizeClassPool<>)->Range(1 << 10, 1 << 16);
+BENCHMARK_TEMPLATE(variable_sizes, NewDeleteResource)->Range(1 << 10, 1 << 16);
+BENCHMARK_TEMPLATE(variable_sizes, std::pmr::unsynchronized_pool_resource)->Range(1 << 10, 1 << 16);
@@ -0,0 +1,54 @@
+#include <benchmark/benchmark.h>
+#include <ez/MemoryPool.hpp>
+#include <ez/ConcurrentMemoryPool.hpp>
+#include <array>
+#include <mutex>
+
+// Every thread allocates a batch of objects then frees them, all threads share one pool.
+// Compares a mutex wrapped MemoryPool against the ConcurrentMemoryPool as the thread count grows.
+
+namespace {
+	constexpr std::size_t batch = 64;
+
+	struct LockedPool {
+		std::mutex mutex;
+		ez::MemoryPool<std::uint64_t> pool;
+
+		std::uint64_t* alloc() {
+			std::lock_guard<std::mutex> lock(mutex);
+			return pool.alloc();
+		}
+		void free(std::uint64_t* obj) {
+			std::lock_guard<std::mutex> lock(mutex);
+			pool.free(obj);
+		}
+	};
+
+	template<typename Pool>
+	void churn(benchmark::State& state, Pool& pool) {
+		std::array<std::uint64_t*, batch> ptrs;
+		for (auto _ : state) {
+			for (std::uint64_t*& ptr : ptrs) {
+				ptr = pool.alloc();
+				*ptr = 0;
+			}
+			benchmark::ClobberMemory();
+			for (std::uint64_t* ptr : ptrs) {
+				pool.free(ptr);
+			}
+		}
+		state.SetItemsProcessed(state.iterations() * batch);
+	}
+}
+
+static void locked_pool_churn(benchmark::State& state) {
+	static LockedPool pool;
+	churn(state, pool);
+}
+BENCHMARK(locked_pool_churn)->ThreadRange(1, 32)->UseRealTime();
+
+static void concurrent_pool_churn(benchmark::State& state) {
+	static ez::ConcurrentMemoryPool<std::uint64_t> pool;
+	churn(state, pool);
+}
+BENCHMARK(concurrent_pool_churn)->ThreadRange(1, 32)->UseRealTime();
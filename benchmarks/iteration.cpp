@@ -0,0 +1,283 @@
+#include <benchmark/benchmark.h>
+#include <ez/MemoryPool.hpp>
+#include <ez/SlotPool.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Compares a full sweep over every object in a pool against a sweep over a std::vector
+
+static void vector_iterate(benchmark::State& state) {
+	std::vector<int> values;
+	for (int64_t i = 0; i < state.range(0); ++i) {
+		values.push_back(static_cast<int>(i));
+	}
+
+	for (auto _ : state) {
+		int64_t sum = 0;
+		for (int val : values) {
+			sum += val;
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(vector_iterate)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
+
+static void pool_iterate(benchmark::State& state) {
+	ez::MemoryPool<int> pool;
+	for (int64_t i = 0; i < state.range(0); ++i) {
+		*pool.alloc() = static_cast<int>(i);
+	}
+
+	for (auto _ : state) {
+		int64_t sum = 0;
+		for (int val : pool) {
+			sum += val;
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(pool_iterate)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
+
+// Every other object freed, so each block is half occupied
+static void pool_iterate_sparse(benchmark::State& state) {
+	ez::MemoryPool<int> pool;
+	std::vector<int*> ptrs;
+	for (int64_t i = 0; i < state.range(0) * 2; ++i) {
+		ptrs.push_back(pool.alloc());
+		*ptrs.back() = static_cast<int>(i);
+	}
+	for (std::size_t i = 0; i < ptrs.size(); i += 2) {
+		pool.free(ptrs[i]);
+	}
+
+	for (auto _ : state) {
+		int64_t sum = 0;
+		for (int val : pool) {
+			sum += val;
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(pool_iterate_sparse)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
+
+// Half the blocks released and regrown between other heap allocations, so blocks are created out of address order
+static void pool_iterate_regrown(benchmark::State& state) {
+	ez::MemoryPool<int> pool;
+	std::vector<int*> ptrs;
+	for (int64_t i = 0; i < state.range(0); ++i) {
+		ptrs.push_back(pool.alloc());
+	}
+	std::mt19937_64 rng{ 42 };
+	for (std::size_t first = 0; first < ptrs.size(); first += 256) {
+		if (rng() % 2 == 0) {
+			for (std::size_t i = first; i < std::min(first + 256, ptrs.size()); ++i) {
+				pool.free(ptrs[i]);
+			}
+		}
+	}
+	pool.shrink();
+	std::vector<std::unique_ptr<char[]>> noise;
+	while (pool.size() < state.range(0)) {
+		if (pool.size() % 256 == 0) {
+			noise.emplace_back(new char[4096]);
+		}
+		*pool.alloc() = 1;
+	}
+	for (int& val : pool) {
+		val = 1;
+	}
+
+	for (auto _ : state) {
+		int64_t sum = 0;
+		for (int val : pool) {
+			sum += val;
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(pool_iterate_regrown)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
+
+// Random churn in batches after most objects were freed, leaving a quarter of them live.
+// alloc() returns a reference to a new object, release(ref) frees one.
+template<typename Ref, typename Alloc, typename Release>
+static std::vector<Ref> randomChurn(std::size_t n, Alloc alloc, Release release) {
+	std::vector<Ref> live;
+	for (std::size_t i = 0; i < n; ++i) {
+		live.push_back(alloc());
+	}
+	std::mt19937_64 rng{ 42 };
+	auto freeRandom = [&]() {
+		std::size_t index = rng() % live.size();
+		release(live[index]);
+		live[index] = live.back();
+		live.pop_back();
+	};
+	while (live.size() > n / 4) {
+		freeRandom();
+	}
+	std::size_t batch = std::max<std::size_t>(n / 256, 16);
+	for (std::size_t churned = 0; churned < n; churned += batch) {
+		for (std::size_t i = 0; i < batch; ++i) {
+			freeRandom();
+		}
+		for (std::size_t i = 0; i < batch; ++i) {
+			live.push_back(alloc());
+		}
+	}
+	return live;
+}
+
+// Sweep what is left of the churn after trimming.
+// The blocks and fill counters show how densely the churn packed the survivors, the pool reuses its fullest blocks first.
+// Compare them with pool_iterate_churned_lifo.
+static void pool_iterate_churned(benchmark::State& state) {
+	ez::MemoryPool<int> pool;
+	std::vector<int*> live = randomChurn<int*>(static_cast<std::size_t>(state.range(0)), [&]() {
+		return pool.alloc();
+	}, [&](int* ptr) {
+		pool.free(ptr);
+	});
+	pool.trim(0);
+	for (int* ptr : live) {
+		*ptr = 1;
+	}
+
+	for (auto _ : state) {
+		int64_t sum = 0;
+		for (int val : pool) {
+			sum += val;
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(pool.size()));
+	state.counters["blocks"] = static_cast<double>(pool.snapshot().blocks);
+	state.counters["fill"] = static_cast<double>(pool.size()) / static_cast<double>(pool.capacity());
+}
+BENCHMARK(pool_iterate_churned)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
+
+// The same churn and sweep on a SlotPool, which uses the same blocks but reuses them LIFO:
+// the block freed into last becomes the one allocated from. This is the policy the MemoryPool had before occupancy bins.
+static void pool_iterate_churned_lifo(benchmark::State& state) {
+	using pool_t = ez::SlotPool<int>;
+	pool_t pool;
+	std::vector<pool_t::handle_type> live = randomChurn<pool_t::handle_type>(static_cast<std::size_t>(state.range(0)), [&]() {
+		return pool.create(1);
+	}, [&](pool_t::handle_type handle) {
+		pool.destroy(handle);
+	});
+	pool.shrink();
+
+	for (auto _ : state) {
+		int64_t sum = 0;
+		for (int val : pool) {
+			sum += val;
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(pool.size()));
+	state.counters["blocks"] = static_cast<double>(pool.capacity() / 256);
+	state.counters["fill"] = static_cast<double>(pool.size()) / static_cast<double>(pool.capacity());
+}
+BENCHMARK(pool_iterate_churned_lifo)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
+
+// Expiry sweep: remove every object older than a cutoff, with erase_if or with an erase loop.
+// The pool is refilled to its size between sweeps, outside of the timing.
+
+struct Entry {
+	std::int64_t expires;
+	std::int64_t payload;
+};
+
+template<bool Bulk>
+static void pool_expire(benchmark::State& state) {
+	ez::MemoryPool<Entry> pool;
+	std::mt19937_64 rng{ 42 };
+	for (int64_t i = 0; i < state.range(0); ++i) {
+		*pool.alloc() = Entry{ static_cast<std::int64_t>(rng() % 1000), i };
+	}
+
+	std::int64_t now = 0;
+	std::size_t expired = 0;
+	for (auto _ : state) {
+		now += 100;
+		if constexpr (Bulk) {
+			expired += pool.erase_if([now](const Entry& entry) {
+				return entry.expires < now;
+			});
+		}
+		else {
+			auto iter = pool.begin();
+			while (iter != pool.end()) {
+				if (iter->expires < now) {
+					iter = pool.erase(iter);
+					++expired;
+				}
+				else {
+					++iter;
+				}
+			}
+		}
+		state.PauseTiming();
+		while (pool.size() < state.range(0)) {
+			*pool.alloc() = Entry{ now + static_cast<std::int64_t>(rng() % 1000), 0 };
+		}
+		state.ResumeTiming();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+	state.counters["expired"] = benchmark::Counter(static_cast<double>(expired), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK_TEMPLATE(pool_expire, false)->RangeMultiplier(16)->Range(1 << 12, 1 << 20);
+BENCHMARK_TEMPLATE(pool_expire, true)->RangeMultiplier(16)->Range(1 << 12, 1 << 20);
+
+// Sums every object, through the iterators or a block at a time with for_each_block.
+// Half of the blocks are full, the others have every fourth slot free.
+
+template<bool Blocks>
+static void pool_sum(benchmark::State& state) {
+	ez::MemoryPool<std::int32_t> pool;
+	std::vector<std::int32_t*> ptrs;
+	for (int64_t i = 0; i < state.range(0); ++i) {
+		ptrs.push_back(pool.create(1));
+	}
+	for (std::size_t i = 0; i < ptrs.size(); i += 4) {
+		if ((i / 256) % 2 == 1) {
+			pool.free(ptrs[i]);
+		}
+	}
+
+	for (auto _ : state) {
+		std::int32_t sum = 0;
+		if constexpr (Blocks) {
+			pool.for_each_block([&sum](std::int32_t* base, std::size_t slots, const std::uint64_t* mask, bool full) {
+				std::int32_t local = 0;
+				if (full) {
+					for (std::size_t i = 0; i < slots; ++i) {
+						local += base[i];
+					}
+				}
+				else {
+					for (std::size_t i = 0; i < slots; ++i) {
+						local += (mask[i / 64] >> (i % 64)) & 1 ? base[i] : 0;
+					}
+				}
+				sum += local;
+			});
+		}
+		else {
+			for (std::int32_t val : pool) {
+				sum += val;
+			}
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * pool.size());
+}
+BENCHMARK_TEMPLATE(pool_sum, false)->RangeMultiplier(16)->Range(1 << 12, 1 << 20);
+BENCHMARK_TEMPLATE(pool_sum, true)->RangeMultiplier(16)->Range(1 << 12, 1 << 20);
@@ -0,0 +1,57 @@
+#include <benchmark/benchmark.h>
+#include <ez/MemoryPool.hpp>
+#include <ez/PersistentPool.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Warm restart: getting back a pool of range(0) records, either by reopening its file or by rebuilding it from a saved copy
+
+namespace {
+	struct Record {
+		std::int64_t id;
+		double value;
+	};
+
+	std::string benchPath() {
+		return (std::filesystem::temp_directory_path() / "ez_pool_persistent_bench.pool").string();
+	}
+}
+
+static void persistent_reopen(benchmark::State& state) {
+	std::string path = benchPath();
+	std::remove(path.c_str());
+	{
+		ez::PersistentPool<Record> pool(path.c_str());
+		for (std::int64_t i = 0; i < state.range(0); ++i) {
+			pool.create(i, double(i));
+		}
+	}
+
+	for (auto _ : state) {
+		ez::PersistentPool<Record> pool(path.c_str());
+		// Touch the first record, so the pool is actually usable
+		benchmark::DoNotOptimize(pool.begin()->id);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+	std::remove(path.c_str());
+}
+BENCHMARK(persistent_reopen)->RangeMultiplier(16)->Range(1 << 12, 1 << 20);
+
+static void pool_rebuild(benchmark::State& state) {
+	std::vector<Record> saved;
+	for (std::int64_t i = 0; i < state.range(0); ++i) {
+		saved.push_back(Record{ i, double(i) });
+	}
+
+	for (auto _ : state) {
+		ez::MemoryPool<Record> pool;
+		for (const Record& record : saved) {
+			pool.create(record);
+		}
+		benchmark::DoNotOptimize(pool.begin()->id);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(pool_rebuild)->RangeMultiplier(16)->Range(1 << 12, 1 << 20);
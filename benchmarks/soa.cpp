@@ -0,0 +1,82 @@
+#include <benchmark/benchmark.h>
+#include <ez/ObjectPool.hpp>
+#include <ez/SoAPool.hpp>
+#include <cstdint>
+
+// Integrates entity positions, one field pass at a time, stored as structs in an ObjectPool and as arrays in a SoAPool
+
+namespace {
+	struct Entity {
+		float x, y, z;
+		float vx, vy, vz;
+		std::uint32_t flags;
+	};
+
+	using EntityArrays = ez::SoAPool<float, float, float, float, float, float, std::uint32_t>;
+
+	constexpr float dt = 1.f / 60.f;
+
+	// Restrict only reliably reaches the vectorizer through parameters
+	void integrate(float* __restrict pos, const float* __restrict vel, std::size_t n) {
+		for (std::size_t i = 0; i < n; ++i) {
+			pos[i] += vel[i] * dt;
+		}
+	}
+}
+
+static void aos_integrate(benchmark::State& state) {
+	ez::ObjectPool<Entity, 256> pool;
+	for (int64_t i = 0; i < state.range(0); ++i) {
+		pool.create(Entity{ 0.f, 0.f, 0.f, 1.f, 2.f, 3.f, 0u });
+	}
+
+	for (auto _ : state) {
+		for (Entity& entity : pool) {
+			entity.x += entity.vx * dt;
+			entity.y += entity.vy * dt;
+			entity.z += entity.vz * dt;
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(aos_integrate)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
+
+// Whole block kernels over the field arrays, free slots hold zeroed values so they need no masking
+static void soa_integrate(benchmark::State& state) {
+	EntityArrays pool;
+	for (int64_t i = 0; i < state.range(0); ++i) {
+		pool.create(0.f, 0.f, 0.f, 1.f, 2.f, 3.f, 0u);
+	}
+	EntityArrays::block_range blocks = pool.blocks();
+
+	for (auto _ : state) {
+		for (const EntityArrays::block_view& view : blocks) {
+			integrate(view.field<0>(), view.field<3>(), view.max_size());
+			integrate(view.field<1>(), view.field<4>(), view.max_size());
+			integrate(view.field<2>(), view.field<5>(), view.max_size());
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(soa_integrate)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
+
+// Row by row iteration, for comparison with the block kernels
+static void soa_integrate_rows(benchmark::State& state) {
+	EntityArrays pool;
+	for (int64_t i = 0; i < state.range(0); ++i) {
+		pool.create(0.f, 0.f, 0.f, 1.f, 2.f, 3.f, 0u);
+	}
+
+	for (auto _ : state) {
+		for (EntityArrays::row row : pool) {
+			row.get<0>() += row.get<3>() * dt;
+			row.get<1>() += row.get<4>() * dt;
+			row.get<2>() += row.get<5>() * dt;
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(soa_integrate_rows)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
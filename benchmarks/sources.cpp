@@ -0,0 +1,30 @@
+#include <benchmark/benchmark.h>
+#include <ez/MemoryPool.hpp>
+#include <ez/BlockSource.hpp>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// Random reads across a large pool, which are dominated by TLB misses when the blocks sit on small pages
+
+template<typename Source>
+static void pool_random_reads(benchmark::State& state) {
+	ez::BasicMemoryPool<std::unordered_map, std::int64_t, 256, false, Source> pool;
+	std::vector<std::int64_t*> ptrs;
+	for (int64_t i = 0; i < state.range(0); ++i) {
+		ptrs.push_back(pool.create(i));
+	}
+	std::shuffle(ptrs.begin(), ptrs.end(), std::mt19937_64{ 42 });
+
+	for (auto _ : state) {
+		int64_t sum = 0;
+		for (std::int64_t* ptr : ptrs) {
+			sum += *ptr;
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(pool_random_reads, ez::NewBlockSource)->RangeMultiplier(16)->Range(1 << 16, 1 << 24);
+BENCHMARK_TEMPLATE(pool_random_reads, ez::MmapBlockSource<>)->RangeMultiplier(16)->Range(1 << 16, 1 << 24);
+BENCHMARK_TEMPLATE(pool_random_reads, ez::HugePageBlockSource<>)->RangeMultiplier(16)->Range(1 << 16, 1 << 24);
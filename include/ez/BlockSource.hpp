@@ -0,0 +1,342 @@
+#pragma once
+#include <new>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cinttypes>
+#include <cassert>
+#include "intern/VirtualMemory.hpp"
+
+namespace ez {
+	/*
+	Block sources supply the raw memory for the blocks of a pool.
+	A source must provide:
+		void* allocate(std::size_t bytes, std::size_t align) noexcept; // Returns nullptr on failure
+		void deallocate(void* ptr, std::size_t bytes, std::size_t align) noexcept;
+	and be move constructible and move assignable. Each pool owns its source.
+	*/
+
+	// Allocates every block individually with operator new, the default.
+	class NewBlockSource {
+	public:
+		void* allocate(std::size_t bytes, std::size_t align) noexcept {
+			if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+				return ::operator new(bytes, std::align_val_t{ align }, std::nothrow);
+			}
+			return ::operator new(bytes, std::nothrow);
+		}
+		void deallocate(void* ptr, std::size_t bytes, std::size_t align) noexcept {
+			(void)bytes;
+			if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+				::operator delete(ptr, std::align_val_t{ align });
+			}
+			else {
+				::operator delete(ptr);
+			}
+		}
+	};
+
+	/*
+	Process wide cache of empty blocks, shared by every pool using a RecyclingBlockSource.
+	Blocks are shelved by size and alignment, so pools of any types with the same block layout reuse each other's blocks,
+	and a burst in one pool leaves blocks behind for the others instead of returning them to the heap.
+	At most limit() bytes are cached, blocks past that are freed. Thread safe, every call takes a lock,
+	which is cheap next to creating a block.
+	*/
+	class BlockRecycler {
+	public:
+		static constexpr std::size_t DefaultLimit = std::size_t(64) << 20;
+
+		// The process wide recycler. It is never destroyed, so pools may still release blocks into it during static destruction.
+		static BlockRecycler& global() {
+			static BlockRecycler* instance = new BlockRecycler{};
+			return *instance;
+		}
+
+		BlockRecycler() noexcept
+			: cachedBytes(0)
+			, limitBytes(DefaultLimit)
+		{}
+		BlockRecycler(const BlockRecycler&) = delete;
+		BlockRecycler& operator=(const BlockRecycler&) = delete;
+		~BlockRecycler() {
+			release();
+		}
+
+		// Take a cached block of the given layout, nullptr if there is none.
+		void* take(std::size_t bytes, std::size_t align) noexcept {
+			std::lock_guard<std::mutex> lock(mutex);
+			for (Shelf& shelf : shelves) {
+				if (shelf.bytes == bytes && shelf.align == align && shelf.first != nullptr) {
+					Piece* piece = shelf.first;
+					shelf.first = piece->next;
+					cachedBytes -= bytes;
+					return piece;
+				}
+			}
+			return nullptr;
+		}
+		// Cache a block allocated with NewBlockSource. Returns false when the cache is full, the caller keeps the block then.
+		bool give(void* ptr, std::size_t bytes, std::size_t align) noexcept {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (bytes < sizeof(Piece) || cachedBytes + bytes > limitBytes) {
+				return false;
+			}
+			Shelf* shelf = findShelf(bytes, align);
+			if (shelf == nullptr) {
+				return false;
+			}
+			shelf->first = new (ptr) Piece{ shelf->first };
+			cachedBytes += bytes;
+			return true;
+		}
+
+		// Free every cached block
+		void release() noexcept {
+			std::lock_guard<std::mutex> lock(mutex);
+			for (Shelf& shelf : shelves) {
+				while (shelf.first != nullptr) {
+					Piece* piece = shelf.first;
+					shelf.first = piece->next;
+					NewBlockSource{}.deallocate(piece, shelf.bytes, shelf.align);
+				}
+			}
+			cachedBytes = 0;
+		}
+
+		// Cache at most bytes worth of blocks, lowering the limit frees cached blocks as needed.
+		void set_limit(std::size_t bytes) noexcept {
+			std::lock_guard<std::mutex> lock(mutex);
+			limitBytes = bytes;
+			for (Shelf& shelf : shelves) {
+				while (cachedBytes > limitBytes && shelf.first != nullptr) {
+					Piece* piece = shelf.first;
+					shelf.first = piece->next;
+					cachedBytes -= shelf.bytes;
+					NewBlockSource{}.deallocate(piece, shelf.bytes, shelf.align);
+				}
+			}
+		}
+		std::size_t limit() const noexcept {
+			std::lock_guard<std::mutex> lock(mutex);
+			return limitBytes;
+		}
+		// Bytes of the blocks currently cached
+		std::size_t cached() const noexcept {
+			std::lock_guard<std::mutex> lock(mutex);
+			return cachedBytes;
+		}
+	private:
+		// Cached blocks are linked through their own memory
+		struct Piece {
+			Piece* next;
+		};
+		struct Shelf {
+			std::size_t bytes, align;
+			Piece* first;
+		};
+
+		mutable std::mutex mutex;
+		// One shelf per block layout, there are only ever a handful
+		std::vector<Shelf> shelves;
+		std::size_t cachedBytes, limitBytes;
+
+		Shelf* findShelf(std::size_t bytes, std::size_t align) noexcept {
+			for (Shelf& shelf : shelves) {
+				if (shelf.bytes == bytes && shelf.align == align) {
+					return &shelf;
+				}
+			}
+			try {
+				shelves.push_back(Shelf{ bytes, align, nullptr });
+			}
+			catch (...) {
+				return nullptr;
+			}
+			return &shelves.back();
+		}
+	};
+
+	// Allocates blocks with operator new, but passes released blocks through the global BlockRecycler,
+	// so pools of different types with the same block layout share their empty blocks.
+	// Pair it with trimming, a pool only releases the blocks that trim() or shrink() remove.
+	class RecyclingBlockSource {
+	public:
+		void* allocate(std::size_t bytes, std::size_t align) noexcept {
+			void* mem = BlockRecycler::global().take(bytes, align);
+			if (mem != nullptr) {
+				return mem;
+			}
+			return NewBlockSource{}.allocate(bytes, align);
+		}
+		void deallocate(void* ptr, std::size_t bytes, std::size_t align) noexcept {
+			if (!BlockRecycler::global().give(ptr, bytes, align)) {
+				NewBlockSource{}.deallocate(ptr, bytes, align);
+			}
+		}
+	};
+
+	/*
+	Maps memory from the operating system in chunks of ChunkBytes, and carves the blocks out of them.
+	Deallocated pieces are kept for reuse, on a list per size and alignment, so a pool growing in chunks (set_growth) can use it too.
+	The chunks themselves are only unmapped when the source is destroyed.
+
+	With HugePages the chunks are aligned to huge page boundaries and backed by huge pages where available,
+	either reserved (MAP_HUGETLB) or transparent (MADV_HUGEPAGE). Large pools then need far fewer TLB entries.
+	*/
+	template<std::size_t ChunkBytes = (std::size_t(1) << 20), bool HugePages = false>
+	class MmapBlockSource {
+	public:
+		MmapBlockSource() noexcept
+			: cursor(nullptr)
+			, limit(nullptr)
+		{}
+		MmapBlockSource(MmapBlockSource&& other) noexcept
+			: chunks(std::move(other.chunks))
+			, shelves(std::move(other.shelves))
+			, cursor(other.cursor)
+			, limit(other.limit)
+		{
+			other.chunks.clear();
+			other.shelves.clear();
+			other.cursor = nullptr;
+			other.limit = nullptr;
+		}
+		~MmapBlockSource() {
+			release();
+		}
+
+		MmapBlockSource& operator=(MmapBlockSource&& other) noexcept {
+			MmapBlockSource copy(std::move(other));
+			swap(copy);
+			return *this;
+		}
+
+		void* allocate(std::size_t bytes, std::size_t align) noexcept {
+			Shelf* shelf = findShelf(bytes, align);
+			if (shelf != nullptr && shelf->head != nullptr) {
+				Piece* piece = shelf->head;
+				shelf->head = piece->next;
+				return piece;
+			}
+
+			char* ptr = alignUp(cursor, align);
+			if (cursor == nullptr || bytes > static_cast<std::size_t>(limit - ptr)) {
+				if (!addChunk(bytes, align)) {
+					return nullptr;
+				}
+				ptr = alignUp(cursor, align);
+			}
+			cursor = ptr + bytes;
+			return ptr;
+		}
+		void deallocate(void* ptr, std::size_t bytes, std::size_t align) noexcept {
+			assert(bytes >= sizeof(Piece) && "The pieces must be large enough to link them!");
+			Shelf* shelf = findShelf(bytes, align);
+			if (shelf == nullptr) {
+				try {
+					shelves.push_back(Shelf{ bytes, align, nullptr });
+				}
+				catch (...) {
+					// The piece is only reclaimed along with its chunk
+					return;
+				}
+				shelf = &shelves.back();
+			}
+			shelf->head = new (ptr) Piece{ shelf->head };
+		}
+
+		// Total bytes mapped from the operating system
+		std::size_t mapped() const noexcept {
+			std::size_t total = 0;
+			for (const Chunk& chunk : chunks) {
+				total += chunk.bytes;
+			}
+			return total;
+		}
+
+		void swap(MmapBlockSource& other) noexcept {
+			chunks.swap(other.chunks);
+			shelves.swap(other.shelves);
+			std::swap(cursor, other.cursor);
+			std::swap(limit, other.limit);
+		}
+	private:
+		struct Chunk {
+			void* base;
+			std::size_t bytes;
+		};
+		// Deallocated pieces are linked through their own memory
+		struct Piece {
+			Piece* next;
+		};
+		// The deallocated pieces of one size and alignment
+		struct Shelf {
+			std::size_t bytes, align;
+			Piece* head;
+		};
+
+		std::vector<Chunk> chunks;
+		// A pool uses one size per block and one per chunk size, so there are few shelves
+		std::vector<Shelf> shelves;
+		// Unused remainder of the newest chunk
+		char* cursor, * limit;
+
+		Shelf* findShelf(std::size_t bytes, std::size_t align) noexcept {
+			for (Shelf& shelf : shelves) {
+				if (shelf.bytes == bytes && shelf.align == align) {
+					return &shelf;
+				}
+			}
+			return nullptr;
+		}
+
+		static char* alignUp(char* ptr, std::size_t align) noexcept {
+			std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(ptr);
+			return reinterpret_cast<char*>((addr + align - 1) & ~static_cast<std::uintptr_t>(align - 1));
+		}
+
+		bool addChunk(std::size_t bytes, std::size_t align) noexcept {
+			// Mappings are only page aligned, so map extra when a larger alignment is needed
+			std::size_t chunkAlign = HugePages ? std::max(align, intern::HugePageBytes) : align;
+			std::size_t size = std::max(ChunkBytes, bytes);
+			if (chunkAlign > intern::pageSize()) {
+				size += chunkAlign;
+			}
+			if constexpr (HugePages) {
+				size = (size + intern::HugePageBytes - 1) & ~(intern::HugePageBytes - 1);
+			}
+
+			void* base = intern::mapPages(size, HugePages);
+			if (base == nullptr) {
+				return false;
+			}
+			try {
+				chunks.push_back(Chunk{ base, size });
+			}
+			catch (...) {
+				intern::unmapPages(base, size);
+				return false;
+			}
+
+			cursor = alignUp(static_cast<char*>(base), chunkAlign);
+			limit = static_cast<char*>(base) + size;
+			return true;
+		}
+
+		void release() noexcept {
+			for (const Chunk& chunk : chunks) {
+				intern::unmapPages(chunk.base, chunk.bytes);
+			}
+			chunks.clear();
+			shelves.clear();
+			cursor = nullptr;
+			limit = nullptr;
+		}
+	};
+
+	// Blocks on huge pages, the chunk size should be a multiple of the huge page size.
+	template<std::size_t ChunkBytes = intern::HugePageBytes * 2>
+	using HugePageBlockSource = MmapBlockSource<ChunkBytes, true>;
+};
@@ -0,0 +1,447 @@
+#pragma once
+#include <new>
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cinttypes>
+#include <cassert>
+#include "intern/MemoryBlock.hpp"
+#include "intern/Bits.hpp"
+#include "intern/ThreadCache.hpp"
+
+namespace ez {
+	/*
+	Thread safe memory pool.
+	Every thread gets its own cache holding the blocks it allocates from, and a magazine of freed slots.
+	Allocating from the magazine or an owned block, and freeing into the magazine, takes no lock.
+	The shared depot of blocks is only locked to take a new block, or to free slots into blocks nobody owns.
+
+	A block stays owned by the thread that took it from the depot until that thread exits or calls flush().
+	Slots freed by other threads are pushed onto a lock free list in their block (the remote free list),
+	and the first push also queues the block on its owner's cache. When the current block runs dry the owner
+	collects the queued blocks and drains their lists in one batch, so objects created on one thread and
+	destroyed on others never lock the pool.
+
+	Blocks are aligned to their power of two rounded size, so the owning block of a slot is found by masking the pointer.
+	Slots sitting in a magazine or an owned block cannot be reclaimed by shrink() until the thread returns them,
+	for example through flush().
+	The pool itself must outlive every thread operation on it, and cannot be moved.
+	*/
+	template<typename T, std::size_t BlockSize = 256, std::size_t MagazineSize = 64>
+	class ConcurrentMemoryPool : private intern::CacheOwner {
+	private:
+		static_assert(MagazineSize >= 2, "MagazineSize must be at least two!");
+		static_assert(BlockSize < (std::size_t(1) << 30), "BlockSize is too large for the remote free list!");
+
+		using Base = intern::MemoryBlock<T, BlockSize>;
+		using index_t = typename Base::index_t;
+
+		struct Cache;
+
+		// Layout of the remote free list word.
+		// The low 32 bits are the index of the last slot pushed, the next 30 bits are the number of slots in the list.
+		// Delayed is set while the owner wants to be told about the next push, Unowned while the block is in the depot.
+		static constexpr std::uint64_t TopMask = 0xFFFFFFFF;
+		static constexpr std::uint64_t CountOne = std::uint64_t(1) << 32;
+		static constexpr std::uint64_t Delayed = std::uint64_t(1) << 62;
+		static constexpr std::uint64_t Unowned = std::uint64_t(1) << 63;
+
+		struct Block : Base {
+			Block() noexcept
+				: owner(nullptr)
+				, remote(Unowned)
+				, nextNotice(nullptr)
+				, ready(false)
+			{}
+
+			// The cache allocating from this block, nullptr while the block sits in the depot.
+			// Only changed with the depot mutex locked.
+			std::atomic<Cache*> owner;
+
+			// Remote free list, slots are linked through their index.
+			std::atomic<std::uint64_t> remote;
+
+			// Link in the notice stack of the owning cache
+			Block* nextNotice;
+
+			// Only used by the owner, set while the block is in the ready list of the cache
+			bool ready;
+		};
+
+		struct Cache {
+			Cache()
+				: top(nullptr)
+				, rounds(0)
+				, count(0)
+				, notices(nullptr)
+			{}
+
+			// Block currently allocated from, only the owning thread touches it
+			Block* top;
+
+			// Freed slots ready to be handed out again
+			std::array<T*, MagazineSize> magazine;
+			std::size_t rounds;
+
+			// Allocations minus frees made through this cache, only written by the owning thread
+			std::atomic<std::ptrdiff_t> count;
+
+			// Blocks with remote frees waiting to be drained, pushed by other threads
+			std::atomic<Block*> notices;
+
+			// Every block owned by this cache, and the owned blocks with openings
+			std::vector<Block*> owned, readyList;
+		};
+
+		static constexpr std::size_t BlockAlign = intern::ceilPow2(sizeof(Block));
+
+		// Protects everything below
+		mutable std::mutex mutex;
+		// Blocks in the depot with openings
+		std::vector<Block*> freeList;
+		// Every allocated block
+		std::vector<Block*> blocks;
+		// Every cache handed out, and the ones whose thread has exited
+		std::vector<std::unique_ptr<Cache>> caches;
+		std::vector<Cache*> idleCaches;
+
+		std::uint64_t id;
+	public:
+		ConcurrentMemoryPool()
+			: id(intern::CacheRegistry::add(this))
+		{}
+		ConcurrentMemoryPool(const ConcurrentMemoryPool&) = delete;
+		ConcurrentMemoryPool& operator=(const ConcurrentMemoryPool&) = delete;
+
+		~ConcurrentMemoryPool() {
+			// After this no exiting thread will touch the pool
+			intern::CacheRegistry::remove(id);
+
+			for (Block* block : blocks) {
+				deallocateBlock(block);
+			}
+		}
+
+		// Returns nullptr if cannot allocate
+		T* alloc() {
+			Cache& cache = localCache();
+			T* obj;
+			if (cache.rounds != 0) {
+				obj = cache.magazine[--cache.rounds];
+			}
+			else {
+				if (cache.top == nullptr || cache.top->numFree == 0) {
+					if (!refill(cache)) {
+						return nullptr;
+					}
+				}
+				obj = cache.top->alloc();
+			}
+
+			cache.count.store(cache.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return obj;
+		}
+
+		// May be called from any thread, not just the one that allocated obj
+		void free(T* obj) {
+			assert(obj != nullptr);
+
+			Cache& cache = localCache();
+			if (cache.rounds == MagazineSize) {
+				returnSlots(cache, MagazineSize / 2);
+			}
+			cache.magazine[cache.rounds++] = obj;
+
+			cache.count.store(cache.count.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+		}
+
+		// forwards parameters to object constructor
+		template<typename ... Ts>
+		T* create(Ts&&... args) {
+			T* obj = alloc();
+			if (obj == nullptr) {
+				return obj;
+			}
+			// Placement new
+			new (obj) T{ std::forward<Ts>(args)... };
+			return obj;
+		}
+
+		// destroys the object and frees its data.
+		void destroy(T* obj) {
+			assert(obj != nullptr);
+			obj->~T();
+			free(obj);
+		}
+
+		// Return every slot cached by the calling thread, and every block it owns, to the depot.
+		void flush() {
+			releaseAll(localCache());
+		}
+
+		// eliminate all depot blocks with no active elements.
+		void shrink() {
+			std::lock_guard<std::mutex> lock(mutex);
+
+			auto iter = freeList.begin();
+			while (iter != freeList.end()) {
+				Block* block = *iter;
+				if (block->empty()) {
+					blocks.erase(std::find(blocks.begin(), blocks.end(), block));
+					deallocateBlock(block);
+					*iter = freeList.back();
+					freeList.pop_back();
+				}
+				else {
+					++iter;
+				}
+			}
+		}
+
+		// Total object capacity available
+		std::ptrdiff_t capacity() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return static_cast<std::ptrdiff_t>(blocks.size() * BlockSize);
+		}
+		// Total number of object allocations, only exact while no other thread uses the pool
+		std::ptrdiff_t size() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			std::ptrdiff_t total = 0;
+			for (const std::unique_ptr<Cache>& cache : caches) {
+				total += cache->count.load(std::memory_order_relaxed);
+			}
+			return total;
+		}
+
+		bool empty() const {
+			return size() == 0;
+		}
+	private:
+		static Block* blockOf(const T* obj) noexcept {
+			return reinterpret_cast<Block*>(reinterpret_cast<std::uintptr_t>(obj) & ~static_cast<std::uintptr_t>(BlockAlign - 1));
+		}
+
+		static Block* allocateBlock() {
+			void* mem = ::operator new(sizeof(Block), std::align_val_t{ BlockAlign }, std::nothrow);
+			if (mem == nullptr) {
+				return nullptr;
+			}
+			return new (mem) Block{};
+		}
+		static void deallocateBlock(Block* block) noexcept {
+			block->~Block();
+			::operator delete(block, std::align_val_t{ BlockAlign });
+		}
+
+		Cache& localCache() {
+			intern::ThreadCaches& local = intern::ThreadCaches::local();
+			void* cache = local.find(id);
+			if (cache == nullptr) {
+				cache = acquireCache();
+				local.insert(id, cache);
+			}
+			return *static_cast<Cache*>(cache);
+		}
+
+		Cache* acquireCache() {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!idleCaches.empty()) {
+				Cache* cache = idleCaches.back();
+				idleCaches.pop_back();
+				return cache;
+			}
+			caches.push_back(std::make_unique<Cache>());
+			return caches.back().get();
+		}
+
+		// Called by the registry on the exiting thread
+		void releaseCache(void* ptr) noexcept override {
+			Cache* cache = static_cast<Cache*>(ptr);
+			releaseAll(*cache);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			idleCaches.push_back(cache);
+		}
+
+		// Find a new block to allocate from, first among the owned blocks, then in the depot.
+		bool refill(Cache& cache) {
+			collectNotices(cache);
+			if (cache.top != nullptr && cache.top->numFree != 0) {
+				return true;
+			}
+
+			if (!cache.readyList.empty()) {
+				cache.top = cache.readyList.back();
+				cache.top->ready = false;
+				cache.readyList.pop_back();
+				return true;
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+
+			Block* block;
+			if (!freeList.empty()) {
+				block = freeList.back();
+				freeList.pop_back();
+			}
+			else {
+				block = allocateBlock();
+				if (block == nullptr) {
+					return false;
+				}
+				blocks.push_back(block);
+			}
+
+			block->owner.store(&cache, std::memory_order_relaxed);
+			block->remote.store(Delayed, std::memory_order_release);
+			cache.owned.push_back(block);
+			cache.top = block;
+			return true;
+		}
+
+		// Drain the remote frees of every block queued on the cache. Only called by the owning thread.
+		void collectNotices(Cache& cache) {
+			Block* block = cache.notices.exchange(nullptr, std::memory_order_acquire);
+			while (block != nullptr) {
+				Block* next = block->nextNotice;
+
+				// Take the list and ask to be told about the next push in one step
+				std::uint64_t head = block->remote.exchange(Delayed, std::memory_order_acq_rel);
+				drainRemote(block, head);
+				markReady(cache, block);
+
+				block = next;
+			}
+		}
+
+		// Free the slots in a remote list value into the block
+		static void drainRemote(Block* block, std::uint64_t head) {
+			std::size_t offset = static_cast<std::size_t>(head & TopMask);
+			for (std::uint64_t count = (head & ~(Delayed | Unowned)) / CountOne; count > 0; --count) {
+				std::size_t next = static_cast<std::size_t>(block->data[offset].index);
+				block->free(&block->data[offset].object);
+				offset = next;
+			}
+		}
+
+		static void markReady(Cache& cache, Block* block) {
+			if (block != cache.top && !block->ready && block->numFree != 0) {
+				block->ready = true;
+				cache.readyList.push_back(block);
+			}
+		}
+
+		// Push a slot onto the remote list of a block owned by another thread.
+		// Fails if the block is in the depot.
+		static bool pushRemote(Block* block, T* obj) {
+			std::uint64_t offset = static_cast<std::uint64_t>(obj - block->basePtr());
+			std::uint64_t head = block->remote.load(std::memory_order_relaxed);
+			std::uint64_t next;
+			do {
+				if (head == Unowned) {
+					return false;
+				}
+				block->data[offset].index = static_cast<index_t>(head & TopMask);
+				next = ((head & ~(Delayed | TopMask)) + CountOne) | offset;
+			} while (!block->remote.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+			if (head & Delayed) {
+				// First push since the owner last looked, queue the block on its cache.
+				// The owner cannot give up the block until it has seen this notice.
+				Cache* owner = block->owner.load(std::memory_order_relaxed);
+				Block* notices = owner->notices.load(std::memory_order_relaxed);
+				do {
+					block->nextNotice = notices;
+				} while (!owner->notices.compare_exchange_weak(notices, block, std::memory_order_release, std::memory_order_relaxed));
+			}
+			return true;
+		}
+
+		// Return the oldest n slots in the magazine to their blocks.
+		void returnSlots(Cache& cache, std::size_t n) {
+			std::array<T*, MagazineSize> unowned;
+			std::size_t numUnowned = 0;
+
+			for (std::size_t i = 0; i < n; ++i) {
+				T* obj = cache.magazine[i];
+				Block* block = blockOf(obj);
+				if (block->owner.load(std::memory_order_relaxed) == &cache) {
+					assert(block->isAllocated(obj) && "The object pointer has already been freed!");
+					block->free(obj);
+					markReady(cache, block);
+				}
+				else if (!pushRemote(block, obj)) {
+					unowned[numUnowned++] = obj;
+				}
+			}
+			std::copy(cache.magazine.begin() + n, cache.magazine.begin() + cache.rounds, cache.magazine.begin());
+			cache.rounds -= n;
+
+			if (numUnowned == 0) {
+				return;
+			}
+
+			// Ownership only changes with the mutex locked
+			std::lock_guard<std::mutex> lock(mutex);
+			for (std::size_t i = 0; i < numUnowned; ++i) {
+				T* obj = unowned[i];
+				Block* block = blockOf(obj);
+				if (block->owner.load(std::memory_order_relaxed) == nullptr) {
+					assert(block->isAllocated(obj) && "The object pointer has already been freed!");
+					block->free(obj);
+					if (block->numFree == 1) {
+						freeList.push_back(block);
+					}
+				}
+				else {
+					// Taken by a thread since the first attempt
+					bool pushed = pushRemote(block, obj);
+					assert(pushed);
+					(void)pushed;
+				}
+			}
+		}
+
+		// Give the magazine and every owned block back to the depot. Only called by the owning thread.
+		void releaseAll(Cache& cache) {
+			returnSlots(cache, cache.rounds);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			cache.top = nullptr;
+			cache.readyList.clear();
+
+			while (!cache.owned.empty()) {
+				collectNotices(cache);
+
+				auto iter = cache.owned.begin();
+				while (iter != cache.owned.end()) {
+					Block* block = *iter;
+
+					// A block without the delayed flag has a notice on the way, it is released on the next pass.
+					std::uint64_t head = Delayed;
+					if (block->remote.compare_exchange_strong(head, Unowned, std::memory_order_acq_rel)) {
+						block->owner.store(nullptr, std::memory_order_relaxed);
+						block->ready = false;
+						if (block->numFree != 0) {
+							freeList.push_back(block);
+						}
+						*iter = cache.owned.back();
+						cache.owned.pop_back();
+					}
+					else {
+						++iter;
+					}
+				}
+
+				if (!cache.owned.empty()) {
+					std::this_thread::yield();
+				}
+			}
+			cache.readyList.clear();
+		}
+	};
+};
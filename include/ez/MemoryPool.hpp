@@ -1,141 +1,108 @@
 #pragma once
 #include <new>
-#include <array>
-#include <memory>
 #include <vector>
 #include <unordered_map>
-#include <algorithm>
+#include <type_traits>
+#include <cstring>
 #include <cinttypes>
 #include <cassert>
-#include "intern/MemoryBlock.hpp"
+#include "intern/PoolCore.hpp"
+#include "intern/TypedIterator.hpp"
+#include "BlockSource.hpp"
+#include "PoolStats.hpp"
 
 namespace ez {
+	// Types that can be moved to a new address with memcpy, skipping the move constructor and destructor.
+	// Specialize to true_type for types that are not trivially copyable but can be relocated bitwise.
+	template<typename T>
+	struct is_trivially_relocatable : std::is_trivially_copyable<T> {};
+
+	template<typename T>
+	inline constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
+
 	/*
 	Can allocate most of the time without referencing the map at all, only one pointer indirection to the topmost block.
-	Can deallocate by accessing the map just once. That should be fairly performant.
+	Deallocation finds the owning block with a single map lookup, keyed by the address divided by the block size.
+	A key covers at most two blocks, so the lookup is constant time whatever the number of blocks.
 	Note that the block size is not bytes, but a number of elements to store.
-	The number of elements cannot currently exceed 256.
+	Blocks of more than 256 elements use a wider free list index, which requires sizeof(T) to be large enough to hold it.
+
+	When Aligned is true every block is placed on a power of two boundary at least as large as the block itself.
+	The owning block of an object is then found by masking the pointer, so free() never touches the map.
+	The map is still used to validate pointers in contains() and find(), and in hardened builds (EZ_POOL_HARDENED) by every free.
+	This trades some memory (the block size is rounded up to a power of two) for faster deallocation.
+
+	The memory of each block comes from the Source, see BlockSource.hpp. By default every block is allocated with operator new.
+	Stats chooses whether the pool counts its allocations, see PoolStats.hpp. The default NoStats compiles away entirely.
+
+	Empty blocks are kept for reuse until shrink() or trim() is called. set_trim() makes trimming automatic:
+	once more than a high watermark of empty blocks pile up, they are trimmed down to a low watermark.
+	Decommitted blocks keep their address range and are reused before any new block is created.
+	set_growth() makes the pool take its blocks from larger chunks, so growing or reserving a large pool takes few allocations,
+	and neighboring blocks are adjacent in memory.
+
+	The pool is a thin typed wrapper over intern::PoolCore, which only depends on sizeof(T) and alignof(T).
+	Pools of types with the same size and alignment share their code, and blocks from one fit any of them.
+
+	Blocks with free slots are binned by occupancy. Once the current block fills up, the next one is taken from the fullest bin,
+	so under random churn the live objects gather in few dense blocks, and the sparse ones drain until they can be trimmed.
 	*/
-	template<template<typename K, typename V> typename map_template, typename T, std::size_t BlockSize = 256>
+	template<template<typename K, typename V> typename map_template, typename T, std::size_t BlockSize = 256, bool Aligned = false, typename Source = NewBlockSource, typename Stats = NoStats>
 	class BasicMemoryPool {
+	public:
+		using core_type = intern::PoolCore<map_template, sizeof(T), alignof(T), BlockSize, Aligned, Source, Stats>;
 	private:
-		static_assert(BlockSize <= 256, "BlockSize currently must be less than or equal to 256!");
-
-		using Block = ez::intern::MemoryBlock<T, BlockSize>;
-		using Alloc = std::array<Block*, 2>;
-
-		using map_t = map_template<std::uintptr_t, Alloc>;
-		using map_iterator = typename map_t::iterator;
-		using const_map_iterator = typename map_t::const_iterator;
-		using block_iterator = typename Block::iterator;
-		
-		// Block size in bytes
-		static constexpr std::ptrdiff_t BlockBytes = sizeof(Block);
-		
-		// List of blocks with openings
-		std::vector<Block*> freeList;
-		// Map of all allocated blocks
-		map_t map;
-
-		// count is the number of allocated objects
-		// bcount is the number of allocated blocks
-		std::ptrdiff_t count, bcount;
-
-		// Top pointer to avoid vector indirection for most allocations.
-		Block* top;
+		using Slot = typename core_type::Slot;
+		using Block = typename core_type::Block;
+
+		static_assert(sizeof(Slot) == sizeof(T) && alignof(Slot) == alignof(T));
+
+		core_type core;
+
+		static T* object(Slot* slot) noexcept {
+			return reinterpret_cast<T*>(slot);
+		}
+		static const T* object(const Slot* slot) noexcept {
+			return reinterpret_cast<const T*>(slot);
+		}
+		static Slot* slot(T* obj) noexcept {
+			return reinterpret_cast<Slot*>(obj);
+		}
+		static const Slot* slot(const T* obj) noexcept {
+			return reinterpret_cast<const Slot*>(obj);
+		}
 	public:
-		class iterator;
-		class const_iterator;
+		using iterator = intern::TypedIterator<typename core_type::iterator, T>;
+		using const_iterator = intern::TypedIterator<typename core_type::const_iterator, const T>;
+		class block_view;
 
-		BasicMemoryPool()
-			: count(0)
-			, bcount(0)
-			, top(nullptr)
+		// Snapshot of the pool's non-empty blocks. It is random access, so it can be split between threads.
+		using block_range = std::vector<block_view>;
+
+		BasicMemoryPool() = default;
+		explicit BasicMemoryPool(Source _source)
+			: core(std::move(_source))
 		{}
-		BasicMemoryPool(BasicMemoryPool && other) noexcept
-			: count(other.count)
-			, bcount(other.bcount)
-			, freeList(std::move(other.freeList))
-			, map(std::move(other.map))
-			, top(other.top)
-		{
-			other.count = 0;
-			other.bcount = 0;
-			other.top = nullptr;
-		}
-		~BasicMemoryPool() {
-			for (auto && iter : map) {
-				if (iter.second[0] != nullptr) {
-					delete iter.second[0];
-				}
-			}
-		}
+		BasicMemoryPool(BasicMemoryPool&& other) noexcept = default;
+		BasicMemoryPool& operator=(BasicMemoryPool&& other) noexcept = default;
 
-		BasicMemoryPool& operator=(BasicMemoryPool&& other) noexcept {
-			count = other.count;
-			bcount = other.bcount;
-			freeList = std::move(other.freeList);
-			map = std::move(other.map);
-			other.count = 0;
-			other.bcount = 0;
-			other.top = nullptr;
-			return *this;
-		}
-		
 		// Returns nullptr if cannot allocate
-		T * alloc() {
-			if (top == nullptr) {
-				top = createBlock();
-				if (top == nullptr) {
-					return nullptr;
-				}
-				
-				freeList.push_back(top);
-			}
-			
-			T* obj = top->alloc();
-
-			// Block used up completely
-			if (top->numFree == 0) {
-				freeList.pop_back();
-				if (!freeList.empty()) {
-					// We have a block with openings available
-					top = freeList.back();
-				}
-				else {
-					// no empty places, next block will be allocated next call to alloc
-					top = nullptr;
-				}
-			}
-			
-			++count;
-			return obj;
+		T* alloc() {
+			return object(core.alloc());
 		}
-
 		void free(T* obj) {
-			std::uintptr_t id = blockId(obj);
-			map_iterator iter = map.find(id);
-
-			// If this triggers, then the obj pointer is not within any valid block range
-			assert(iter != map.end());
-
-			// Check both blocks in the mapping
-			for (Block * block : iter->second) {
-				if (Block::contains(block, obj)) {
-
-					// If this triggers, the obj pointer has already been freed.
-					assert(block->isAllocated(obj) && "The object pointer has already been freed!");
-
-					block->free(obj);
-					if (block->numFree == 1) {
-						freeList.push_back(block);
-						top = block;
-					}
-					--count;
-					return;
-				}
-			}
-			assert(false); // This assertion triggers if the obj is not from this pool
+			core.free(slot(obj));
+		}
+
+		// Allocate n objects into out, filling whole blocks at a time.
+		// Returns the number of objects allocated, which is less than n only if a block could not be allocated.
+		std::size_t alloc_n(T** out, std::size_t n) {
+			return core.alloc_n(reinterpret_cast<Slot**>(out), n);
+		}
+		// Free n objects, in any order. Pointers into the same block share a single block lookup,
+		// whether they are consecutive or shuffled with pointers into other blocks.
+		void free_n(T* const* objs, std::size_t n) {
+			core.free_n(reinterpret_cast<Slot* const*>(objs), n);
 		}
 
 		// forwards parameters to object constructor
@@ -150,397 +117,289 @@ namespace ez {
 			return obj;
 		}
 
+		// Create n objects into out, each constructed from the same parameters.
+		// Returns the number of objects created.
+		template<typename ... Ts>
+		std::size_t create_n(T** out, std::size_t n, const Ts&... args) {
+			std::size_t done = alloc_n(out, n);
+			for (std::size_t i = 0; i < done; ++i) {
+				new (out[i]) T{ args... };
+			}
+			return done;
+		}
+
 		// destroys the object and frees its data.
+		// Hardened builds check the pointer first, a bad one is reported and neither destroyed nor freed.
 		void destroy(T * obj) {
 			assert(obj != nullptr);
+#if defined(EZ_POOL_HARDENED)
+			Block* block = core.check(slot(obj));
+			if (block == nullptr) {
+				return;
+			}
+			obj->~T();
+			core.free(block, slot(obj));
+#else
 			obj->~T();
 			free(obj);
+#endif
+		}
+
+		// destroys n objects and frees their data.
+		// Hardened builds destroy and free them one at a time, so a pointer repeated in objs is caught before its second destructor call.
+		void destroy_n(T* const* objs, std::size_t n) {
+#if defined(EZ_POOL_HARDENED)
+			for (std::size_t i = 0; i < n; ++i) {
+				destroy(objs[i]);
+			}
+#else
+			for (std::size_t i = 0; i < n; ++i) {
+				assert(objs[i] != nullptr);
+				objs[i]->~T();
+			}
+			free_n(objs, n);
+#endif
 		}
 
 		// destroy all, then clear
 		void destroy_clear() {
-			for (T & obj : *this) {
-				obj.~T();
+			if constexpr (!std::is_trivially_destructible_v<T>) {
+				for (T & obj : *this) {
+					obj.~T();
+				}
 			}
 			clear();
 		}
 
 		// eliminate all allocated blocks with no active elements.
 		void shrink() {
-			auto iter = freeList.begin();
-			while (iter != freeList.end()) {
-				Block* block = *iter;
-				if (block->numFree == BlockSize) {
-					destroyBlock(block);
-					--bcount;
-					*iter = freeList.back();
-					freeList.pop_back();
+			core.shrink();
+		}
+
+		// Remove spare empty blocks until at most keep of them remain, either releasing them or decommitting their pages.
+		// Decommitting only frees memory for blocks spanning whole pages, the block header always stays resident.
+		// An empty top block is kept.
+		void trim(std::size_t keep, TrimMode mode = TrimMode::Release) {
+			core.trim(keep, mode);
+		}
+
+		// Trim automatically whenever more than high empty blocks are spare, down to low.
+		// The gap between the watermarks keeps a pool that hovers around one size from creating and trimming blocks over and over.
+		void set_trim(std::size_t low, std::size_t high, TrimMode mode = TrimMode::Release) {
+			core.set_trim(low, high, mode);
+		}
+		// Turn automatic trimming off, the default.
+		void disable_trim() noexcept {
+			core.disable_trim();
+		}
+
+		// Carve new blocks out of chunks allocated from the source in one piece, the first holding first blocks,
+		// each one after it twice as many as the last, up to max. reserve() sizes its chunks for what it needs, up to max.
+		// A chunk goes back to the source once all of its blocks are released, the pages of the blocks released before that are decommitted.
+		// The source is then asked for pieces of several sizes, which every source in BlockSource.hpp serves.
+		// By default every block is allocated on its own, as set_growth(1, 1) does.
+		void set_growth(std::size_t first, std::size_t max) noexcept {
+			core.set_growth(first, max);
+		}
+
+		// Move objects out of the sparsest blocks into the free slots of the densest ones, then release every empty block.
+		// Every allocated slot must hold a constructed object. For each object moved, fn(from, to) is called after the move,
+		// so references can be patched. The from address no longer holds an object at that point.
+		// Returns the number of objects moved.
+		template<typename F>
+		std::size_t compact(F&& fn) {
+			static_assert(is_trivially_relocatable_v<T> || std::is_nothrow_move_constructible_v<T>,
+				"Compaction requires a trivially relocatable or nothrow move constructible type!");
+
+			auto relocate = [](Slot* from, Slot* to) {
+				if constexpr (is_trivially_relocatable_v<T>) {
+					std::memcpy(static_cast<void*>(to), static_cast<const void*>(from), sizeof(T));
 				}
 				else {
-					++iter;
+					T* obj = std::launder(object(from));
+					new (object(to)) T(std::move(*obj));
+					obj->~T();
 				}
-			}
-
-			if (!freeList.empty()) {
-				top = freeList.back();
-			}
-			else {
-				top = nullptr;
-			}
+			};
+			return core.compact(relocate, [&fn](const Slot* from, Slot* to) {
+				fn(reinterpret_cast<const T*>(from), object(to));
+			});
+		}
+		// Compact without observing the moves, for pools that are only reached through iteration.
+		std::size_t compact() {
+			return compact([](const T*, T*) {});
 		}
 
 		// attempt to reserve storage for 'cap' elements. Automatically rounds up to multiple of BlockSize
 		void reserve(std::size_t cap) {
-			std::size_t mod = cap % BlockSize;
-			if (mod != 0) {
-				cap += BlockSize - mod;
-			}
-			
-			std::size_t nblocks = cap / BlockSize;
-			while (bcount < nblocks) {
-				Block* block = createBlock();
-				if (block == nullptr) {
-					break;
-				}
-				freeList.push_back(block);
-			}
-			top = freeList.back();
+			core.reserve(cap);
 		}
 
 		// Free all blocks WITHOUT calling destructors for the contained elements.
 		// It is undefined behavior to call this method when elements have been constructed and have non-trivial destructors.
 		void clear() {
-			freeList.clear();
-			for (auto&& iter : map) {
-				if (iter.second[0] != nullptr) {
-					delete iter.second[0];
-				}
-			}
-			map.clear();
-			count = 0;
-			bcount = 0;
-			top = nullptr;
+			core.clear();
 		}
 
 		// Total object capacity available
 		ptrdiff_t capacity() const noexcept {
-			return static_cast<std::ptrdiff_t>(bcount * BlockSize);
+			return core.capacity();
 		}
 		// Total number of object allocations
 		ptrdiff_t size() const noexcept {
-			return count;
+			return core.size();
 		}
 
 		bool empty() const noexcept {
-			return size() == 0;
+			return core.empty();
 		}
 
 		iterator begin() noexcept {
-			return iterator(map.begin(), map.end());
+			return iterator(core.begin());
 		}
 		iterator end() noexcept {
-			return iterator(map.end(), map.end());
+			return iterator(core.end());
 		}
 
 		const_iterator begin() const noexcept {
-			return const_iterator(const_cast<BasicMemoryPool*>(this)->begin());
+			return const_iterator(core.begin());
 		}
 		const_iterator end() const noexcept {
-			return const_iterator(const_cast<BasicMemoryPool*>(this)->end());
+			return const_iterator(core.end());
 		}
 
 		const_iterator cbegin() const noexcept {
-			return const_iterator(const_cast<BasicMemoryPool*>(this)->begin());
+			return begin();
 		}
 		const_iterator cend() const noexcept {
-			return const_iterator(const_cast<BasicMemoryPool*>(this)->end());
+			return end();
 		}
 
-		iterator erase(const_iterator _pos) {
-			iterator pos = _pos._inner;
-			assert(pos != end());
+		// Views of every block holding at least one object.
+		// The range is invalidated by any operation that creates or destroys blocks.
+		block_range blocks() {
+			return core.template blocks<block_view>();
+		}
 
-			Block* block = pos.blockIter.getBlock();
-			pos.blockIter = block->erase(pos.blockIter);
-			if (block->numFree == 1) {
-				freeList.push_back(block);
-				top = block;
-			}
-			--count;
+		// Number of 64 bit words in the occupancy mask passed by for_each_block
+		static constexpr std::size_t mask_words = intern::wordCount(BlockSize);
+
+		// Call fn(T* base, std::size_t slots, const std::uint64_t* mask, bool full) for every block holding at least one object,
+		// so a kernel can process a whole block at a time instead of going through the iterators.
+		// The slots of a block are the contiguous array base[0, slots), slot i holds an object when bit i % 64 of mask[i / 64] is set.
+		// When full is true every slot holds an object and the mask can be skipped.
+		// Free slots must not be touched, hardened builds poison them. fn must not allocate from or free to the pool.
+		template<typename Fn>
+		void for_each_block(Fn fn) {
+			core.for_each_block([&fn](Slot* base, std::size_t slots, const std::uint64_t* mask, bool full) {
+				fn(std::launder(object(base)), slots, mask, full);
+			});
+		}
+		template<typename Fn>
+		void for_each_block(Fn fn) const {
+			core.for_each_block([&fn](const Slot* base, std::size_t slots, const std::uint64_t* mask, bool full) {
+				fn(std::launder(object(base)), slots, mask, full);
+			});
+		}
 
-			if (pos.blockIter.atEnd()) {
-				pos.nextBlock();
-			}
+		iterator erase(const_iterator pos) {
+			return iterator(core.erase(pos.base()));
+		}
 
-			return pos;
+		// Free every object for which pred(obj) returns true, WITHOUT calling its destructor, like erase().
+		// Works a block at a time, updating the pool's bookkeeping once per block. Returns the number of objects freed.
+		template<typename Pred>
+		std::size_t erase_if(Pred pred) {
+			return core.erase_if([&pred](Slot* slot) {
+				return static_cast<bool>(pred(*std::launder(object(slot))));
+			});
+		}
+		// Destroy and free every object for which pred(obj) returns true, a block at a time.
+		// Returns the number of objects destroyed.
+		template<typename Pred>
+		std::size_t destroy_if(Pred pred) {
+			return core.erase_if([&pred](Slot* slot) {
+				T* obj = std::launder(object(slot));
+				if (!pred(*obj)) {
+					return false;
+				}
+				obj->~T();
+				return true;
+			});
 		}
 
 		void swap(BasicMemoryPool& other) noexcept {
-			map.swap(other.map);
-			freeList.swap(other.freeList);
-			std::swap(count, other.count);
-			std::swap(top, other.top);
+			core.swap(other.core);
 		}
 
 		bool contains(const T* obj) const {
-			std::uintptr_t id = blockId(obj);
-			const_map_iterator iter = map.find(id);
-
-			if (iter != map.end()) {
-				return Block::contains(iter->second[0], obj) || Block::contains(iter->second[1], obj);
-			}
-			else {
-				return false;
-			}
+			return core.contains(slot(obj));
 		}
 
-		iterator find(const T* obj) {
-			std::uintptr_t id = blockId(obj);
-			map_iterator iter = map.find(id);
+		const Stats& get_stats() const noexcept {
+			return core.get_stats();
+		}
 
-			if (iter != map.end()) {
-				if (Block::contains(iter->second[0], obj)) {
-					return iterator(iter, map.end(), obj - iter->second[0]->basePtr());
-				}
-				else if (Block::contains(iter->second[1], obj)) {
-					return iterator(iter, map.end(), obj - iter->second[1]->basePtr());
-				}
-				else {
-					return end();
-				}
-			}
-			else {
-				return end();
-			}
+		// Counters from the stats policy, plus the current layout of the pool.
+		// Walks every block to build the occupancy histogram.
+		PoolSnapshot snapshot() const {
+			return core.snapshot();
 		}
-		const_iterator find(const T* obj) const {
-			std::uintptr_t id = blockId(obj);
-			const_map_iterator iter = map.find(id);
 
-			if (iter != map.end()) {
-				if (Block::contains(iter->second[0], obj)) {
-					return const_iterator(iter, map.end(), obj - iter->second[0]->basePtr());
-				}
-				else if (Block::contains(iter->second[1], obj)) {
-					return const_iterator(iter, map.end(), obj - iter->second[1]->basePtr());
-				}
-				else {
-					return end();
-				}
-			}
-			else {
-				return end();
-			}
+		Source& get_source() noexcept {
+			return core.get_source();
 		}
-	private:
-		// Calculate a block multiple from an object pointer
-		static std::uintptr_t blockId(const T* base) noexcept {
-			return reinterpret_cast<std::uintptr_t>(base) / BlockBytes;
+		const Source& get_source() const noexcept {
+			return core.get_source();
 		}
 
-		// Create a new block, insert it into the map, and return the pointer to the new block.
-		// Returns nullptr if allocation fails.
-		Block * createBlock() {
-			Block* block = new Block{};
-			if (!block) {
-				return nullptr;
-			}
-			++bcount;
-
-			std::uintptr_t low = blockId(block->basePtr());
-			std::uintptr_t high = low + 1;
-			
-			auto iter = map.find(low);
-			
-			if (iter == map.end()) {
-				// If low is NOT in map, add to map as the second half of alloc
-				map.insert(iter, { low, Alloc{ nullptr, block } });
-			}
-			else {
-				// If low is in map already, set the second half of alloc to new block 
-				assert(iter->second[1] == nullptr);
-				iter->second[1] = block;
-			}
-
-			iter = map.find(high);
-			if (iter == map.end()) {
-				// If low is NOT in map, add to map as the first half of alloc
-				map.insert(iter, {high, Alloc{ block, nullptr }});
-			}
-			else {
-				// If low is in map already, set the first half of alloc to new block
-				assert(iter->second[0] == nullptr);
-				iter->second[0] = block;
-			}
-
-			return block;
+		iterator find(const T* obj) {
+			return iterator(core.find(slot(obj)));
 		}
-		void destroyBlock(Block * block) {
-			std::uintptr_t low = blockId(block->basePtr());
-			std::uintptr_t high = low + 1;
-
-			auto iter = map.find(low);
-			assert(iter != map.end()); // The block must exist
-
-			assert(iter->second[1] == block);
-			iter->second[1] = nullptr;
-			if (iter->second[0] == nullptr) {
-				map.erase(iter);
-			}
-
-			iter = map.find(high);
-			assert(iter != map.end()); // The block must exist
-
-			assert(iter->second[0] == block);
-			iter->second[0] = nullptr;
-			if (iter->second[1] == nullptr) {
-				map.erase(iter);
-			}
-
-			--bcount;
-			delete block;
+		const_iterator find(const T* obj) const {
+			return const_iterator(core.find(slot(obj)));
 		}
 
-		
-	public:
-		class iterator {
-			bool validBlock() const noexcept {
-				return (mapIter->second[0] != nullptr) && (mapIter->second[0]->size() != 0);
-			}
+		// A single block of the pool, iterating it visits the objects allocated in that block.
+		class block_view {
 		public:
-			using iterator_category = std::forward_iterator_tag;
-			using value_type = T;
-			using reference = value_type&;
-			using pointer = value_type*;
-			using difference_type = std::ptrdiff_t;
-
-			iterator() noexcept = default;
-			~iterator() = default;
-			iterator(const iterator& other) noexcept = default;
-			iterator& operator=(const iterator & other) noexcept = default;
-
-			iterator(map_iterator it, map_iterator end) noexcept
-				: mapIter(it)
-				, mapEnd(end)
-			{
-				if (mapIter != mapEnd) {
-					if (validBlock()) {
-						blockIter = mapIter->second[0]->begin();
-					}
-					else {
-						nextBlock();
-					}
-				}
-			}
-			iterator(map_iterator it, map_iterator end, block_iterator bit) noexcept
-				: mapIter(it)
-				, mapEnd(end)
-				, blockIter(bit)
-			{}
-
-
-			iterator& operator++() {
-				++blockIter;
-				if (blockIter.atEnd()) {
-					nextBlock();
-				}
-				return *this;
-			}
-			iterator operator++(int) {
-				iterator copy = *this;
-				++(*this);
-				return copy;
-			}
+			using iterator = intern::TypedIterator<typename core_type::block_iterator, T>;
 
-			bool operator==(const iterator& other) const noexcept {
-				return (mapIter == other.mapIter) && (blockIter == other.blockIter);
-			}
-			bool operator!=(const iterator& other) const noexcept {
-				return (mapIter != other.mapIter) || (blockIter != other.blockIter);
-			}
-
-			reference operator*() noexcept {
-				return *blockIter;
-			}
-			pointer operator->() noexcept {
-				return &*blockIter;
-			}
-		protected:
-			friend class BasicMemoryPool;
-			map_iterator mapIter, mapEnd;
-			block_iterator blockIter;
-
-			void nextBlock() {
-				blockIter = block_iterator{};
-
-				++mapIter;
-				while (mapIter != mapEnd) {
-					if (validBlock()) {
-						blockIter = mapIter->second[0]->begin();
-						break;
-					}
-					++mapIter;
-				}
-			}
-		}; // End iterator
-		
-		class const_iterator {
-		public:
-			using iterator_category = std::forward_iterator_tag;
-			using value_type = const T;
-			using reference = value_type&;
-			using pointer = value_type*;
-			using difference_type = std::ptrdiff_t;
-
-			const_iterator() noexcept = default;
-			~const_iterator() = default;
-			const_iterator(const const_iterator&) noexcept = default;
-			const_iterator& operator=(const const_iterator&) noexcept = default;
-
-			const_iterator(map_iterator it, map_iterator end) noexcept
-				: _inner(it, end)
-			{}
-			const_iterator(map_iterator it, map_iterator end, typename Block::iterator bit) noexcept
-				: _inner(it, end, bit)
+			block_view() noexcept
+				: block(nullptr)
 			{}
-
-			const_iterator(const iterator & other) noexcept
-				: _inner(other)
+			explicit block_view(Block* _block) noexcept
+				: block(_block)
 			{}
-			const_iterator& operator=(const iterator& other) noexcept {
-				_inner = other;
-				return *this;
-			}
-
-			const_iterator& operator++() noexcept {
-				++_inner;
-				return *this;
-			}
-			const_iterator operator++(int) noexcept {
-				const_iterator copy = *this;
-				++(*this);
-				return copy;
-			}
 
-			bool operator==(const const_iterator& other) const noexcept {
-				return _inner == other._inner;
+			iterator begin() const noexcept {
+				return iterator(block->begin());
 			}
-			bool operator!=(const const_iterator& other) const noexcept {
-				return _inner != other._inner;
+			iterator end() const noexcept {
+				return iterator(block->end());
 			}
 
-			reference operator*() noexcept {
-				return *_inner;
+			// Number of objects allocated in the block
+			std::size_t size() const noexcept {
+				return block->size();
 			}
-			pointer operator->() noexcept {
-				return &*_inner;
+			static constexpr std::size_t max_size() noexcept {
+				return BlockSize;
 			}
 		private:
-			friend class BasicMemoryPool;
-			iterator _inner;
+			Block* block;
 		};
 	};
 	
+	// Free the objects matching pred, see BasicMemoryPool::erase_if
+	template<template<typename K, typename V> typename map_template, typename T, std::size_t BlockSize, bool Aligned, typename Source, typename Stats, typename Pred>
+	std::size_t erase_if(BasicMemoryPool<map_template, T, BlockSize, Aligned, Source, Stats>& pool, Pred pred) {
+		return pool.erase_if(std::move(pred));
+	}
+
 	template<typename T, std::size_t N = 256>
 	using MemoryPool = BasicMemoryPool<std::unordered_map, T, N>;
+
+	template<typename T, std::size_t N = 256>
+	using AlignedMemoryPool = BasicMemoryPool<std::unordered_map, T, N, true>;
 };
\ No newline at end of file
@@ -6,16 +6,21 @@ namespace ez {
 	Live memory pool, does not allow allocation of uninitialized memory. Only allows construction in place, and destruction.
 
 	*/
-	template<template<typename K, typename V> typename map_template, typename T, std::size_t N>
+	template<template<typename K, typename V> typename map_template, typename T, std::size_t N, bool Aligned = false, typename Source = NewBlockSource, typename Stats = NoStats>
 	class BasicObjectPool  {
 	public:
-		using self_t = BasicObjectPool<map_template, T, N>;
-		using parent_type = BasicMemoryPool<map_template, T, N>;
+		using self_t = BasicObjectPool<map_template, T, N, Aligned, Source, Stats>;
+		using parent_type = BasicMemoryPool<map_template, T, N, Aligned, Source, Stats>;
 		using iterator = typename parent_type::iterator;
 		using const_iterator = typename parent_type::const_iterator;
+		using block_view = typename parent_type::block_view;
+		using block_range = typename parent_type::block_range;
 
 		BasicObjectPool()
 		{}
+		explicit BasicObjectPool(Source source)
+			: mpool(std::move(source))
+		{}
 		BasicObjectPool(BasicObjectPool&& other) noexcept
 			: mpool(std::move(other.mpool))
 		{}
@@ -33,14 +38,46 @@ namespace ez {
 			return mpool.create(std::forward<Ts>(args)...);
 		}
 
+		// Create n objects into out, each constructed from the same parameters.
+		// Returns the number of objects created.
+		template<typename ... Ts>
+		std::size_t create_n(T** out, std::size_t n, const Ts&... args) {
+			return mpool.create_n(out, n, args...);
+		}
+
 		void destroy(T* obj) {
 			mpool.destroy(obj);
 		}
 
+		void destroy_n(T* const* objs, std::size_t n) {
+			mpool.destroy_n(objs, n);
+		}
+
 		void shrink() {
 			mpool.shrink();
 		}
 
+		void trim(std::size_t keep, TrimMode mode = TrimMode::Release) {
+			mpool.trim(keep, mode);
+		}
+		void set_trim(std::size_t low, std::size_t high, TrimMode mode = TrimMode::Release) {
+			mpool.set_trim(low, high, mode);
+		}
+		void disable_trim() noexcept {
+			mpool.disable_trim();
+		}
+		void set_growth(std::size_t first, std::size_t max) noexcept {
+			mpool.set_growth(first, max);
+		}
+
+		template<typename F>
+		std::size_t compact(F&& fn) {
+			return mpool.compact(std::forward<F>(fn));
+		}
+		std::size_t compact() {
+			return mpool.compact();
+		}
+
 		void reserve(size_t cap) {
 			mpool.reserve(cap);
 		}
@@ -81,10 +118,34 @@ namespace ez {
 			return mpool.cend();
 		}
 
+		block_range blocks() {
+			return mpool.blocks();
+		}
+
+		static constexpr std::size_t mask_words = parent_type::mask_words;
+
+		// Call fn(T* base, std::size_t slots, const std::uint64_t* mask, bool full) for every block holding at least one object.
+		// See BasicMemoryPool::for_each_block
+		template<typename Fn>
+		void for_each_block(Fn fn) {
+			mpool.for_each_block(std::move(fn));
+		}
+		template<typename Fn>
+		void for_each_block(Fn fn) const {
+			mpool.for_each_block(std::move(fn));
+		}
+
 		iterator erase(const_iterator pos) {
 			return mpool.erase(pos);
 		}
 
+		// Destroy every object for which pred(obj) returns true, a block at a time.
+		// Returns the number of objects destroyed.
+		template<typename Pred>
+		std::size_t destroy_if(Pred pred) {
+			return mpool.destroy_if(std::move(pred));
+		}
+
 		void swap(self_t& other) noexcept {
 			mpool.swap(other.mpool);
 		}
@@ -99,11 +160,34 @@ namespace ez {
 			return mpool.find(obj);
 		}
 
+		const Stats& get_stats() const noexcept {
+			return mpool.get_stats();
+		}
+		PoolSnapshot snapshot() const {
+			return mpool.snapshot();
+		}
+
+		Source& get_source() noexcept {
+			return mpool.get_source();
+		}
+		const Source& get_source() const noexcept {
+			return mpool.get_source();
+		}
+
 
 	private:
 		parent_type mpool;
 	};
 
+	// Destroy the objects matching pred, see BasicObjectPool::destroy_if
+	template<template<typename K, typename V> typename map_template, typename T, std::size_t N, bool Aligned, typename Source, typename Stats, typename Pred>
+	std::size_t erase_if(BasicObjectPool<map_template, T, N, Aligned, Source, Stats>& pool, Pred pred) {
+		return pool.destroy_if(std::move(pred));
+	}
+
 	template<typename T, std::size_t N = 256>
 	using ObjectPool = BasicObjectPool<std::unordered_map, T, N>;
+
+	template<typename T, std::size_t N = 256>
+	using AlignedObjectPool = BasicObjectPool<std::unordered_map, T, N, true>;
 };
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+#include <algorithm>
+#include <execution>
+#include <type_traits>
+#include "ThreadPool.hpp"
+
+namespace ez {
+	// Run fn on every object in the pool, handing whole blocks to a standard execution policy.
+	template<typename ExecutionPolicy, typename Pool, typename F,
+		typename = std::enable_if_t<std::is_execution_policy_v<std::decay_t<ExecutionPolicy>>>>
+	void for_each(ExecutionPolicy&& policy, Pool& pool, F fn) {
+		typename Pool::block_range range = pool.blocks();
+		std::for_each(std::forward<ExecutionPolicy>(policy), range.begin(), range.end(), [&](const typename Pool::block_view& view) {
+			for (auto& obj : view) {
+				fn(obj);
+			}
+		});
+	}
+};
@@ -0,0 +1,615 @@
+#pragma once
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <iterator>
+#include <type_traits>
+#include <cinttypes>
+#include <cstddef>
+#include <cassert>
+#include "intern/MemoryBlock.hpp"
+
+#if defined(_WIN32)
+#error "ez::PersistentPool needs POSIX mmap, it is not available on Windows"
+#endif
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace ez {
+	// Pointer stored as an offset from its own address, so it stays valid wherever the memory holding it is mapped.
+	// Both the pointer and its target must live in the same mapping, for example the same PersistentPool.
+	template<typename U>
+	class OffsetPtr {
+	public:
+		OffsetPtr() noexcept
+			: offset(Null)
+		{}
+		OffsetPtr(std::nullptr_t) noexcept
+			: offset(Null)
+		{}
+		OffsetPtr(U* ptr) noexcept {
+			set(ptr);
+		}
+		// Copies point at the same target, so the offset is recomputed from the new address
+		OffsetPtr(const OffsetPtr& other) noexcept {
+			set(other.get());
+		}
+		OffsetPtr& operator=(const OffsetPtr& other) noexcept {
+			set(other.get());
+			return *this;
+		}
+		OffsetPtr& operator=(U* ptr) noexcept {
+			set(ptr);
+			return *this;
+		}
+
+		U* get() const noexcept {
+			if (offset == Null) {
+				return nullptr;
+			}
+			return reinterpret_cast<U*>(reinterpret_cast<std::uintptr_t>(this) + static_cast<std::uintptr_t>(offset));
+		}
+
+		U& operator*() const noexcept {
+			return *get();
+		}
+		U* operator->() const noexcept {
+			return get();
+		}
+		explicit operator bool() const noexcept {
+			return offset != Null;
+		}
+
+		bool operator==(const OffsetPtr& other) const noexcept {
+			return get() == other.get();
+		}
+		bool operator!=(const OffsetPtr& other) const noexcept {
+			return get() != other.get();
+		}
+	private:
+		// An offset of one never points at a valid U sharing a mapping with the pointer, except for U of alignment one
+		static constexpr std::ptrdiff_t Null = 1;
+
+		std::ptrdiff_t offset;
+
+		void set(U* ptr) noexcept {
+			if (ptr == nullptr) {
+				offset = Null;
+			}
+			else {
+				offset = static_cast<std::ptrdiff_t>(reinterpret_cast<std::uintptr_t>(ptr) - reinterpret_cast<std::uintptr_t>(this));
+				assert(offset != Null && "OffsetPtr cannot point one byte past itself!");
+			}
+		}
+	};
+
+	// Types whose bytes stay meaningful when written to a file and mapped again at another address.
+	// Specialize to true_type for types that are only made of trivially copyable members and OffsetPtrs.
+	template<typename T>
+	struct is_persistable : std::is_trivially_copyable<T> {};
+
+	template<typename U>
+	struct is_persistable<OffsetPtr<U>> : std::true_type {};
+
+	template<typename T>
+	inline constexpr bool is_persistable_v = is_persistable<T>::value;
+
+	/*
+	Pool whose blocks live in a memory mapped file, so its objects survive the process.
+	Opening the file again gives back the pool as it was left: the blocks are stored with their occupancy bitmap and free list,
+	so iteration, alloc and free work right away, without reading or rebuilding any object.
+
+	The file starts with a header recording the layout (sizeof(T), alignof(T), BlockSize and the block size in bytes),
+	and opening a file written with another layout fails. The blocks follow the header back to back,
+	so block i is found at a fixed offset and the header's block count is the whole directory.
+	Only the small list of blocks with free slots is kept in memory, rebuilt on open from the blocks' free counts.
+	The blocks are ordinary MemoryBlocks. Their free list holds slot indices, so it stays valid at any address,
+	and their intrusive list pointers are never used here.
+
+	The mapping is placed inside an address range reserved up front, max_bytes long, and the file grows in place within it.
+	Objects therefore keep their address for as long as the pool is open, but not across opens:
+	pointers between objects must be OffsetPtrs, or indices.
+
+	The file is written through the shared mapping, flush() waits until it has reached the disk.
+	Nothing is journaled, a crash in the middle of alloc or free may leave that block inconsistent.
+	Like the other pools it is not thread safe, and the file must not be opened by two pools at once.
+	*/
+	template<typename T, std::size_t BlockSize = 256>
+	class PersistentPool {
+	private:
+		using Block = intern::MemoryBlock<T, BlockSize>;
+
+		static_assert(is_persistable_v<T>, "PersistentPool requires a trivially copyable type, or a type specializing ez::is_persistable!");
+
+		// Identifies the files written by a PersistentPool, and the version of their layout
+		static constexpr std::uint64_t Magic = 0x4C4F4F50505A45ull; // "EZPPOOL"
+#if defined(EZ_POOL_HARDENED)
+		// The free slots of hardened builds hold a poison pattern, so their files are kept apart
+		static constexpr std::uint32_t Version = 1 | 0x80000000u;
+#else
+		static constexpr std::uint32_t Version = 1;
+#endif
+
+		struct Header {
+			std::uint64_t magic;
+			std::uint32_t version;
+			std::uint32_t dataOffset;
+			std::uint64_t objectSize, objectAlign;
+			std::uint64_t blockSize, blockBytes;
+			// Number of blocks in the file, only raised once a new block has been set up
+			std::uint64_t blocks;
+		};
+
+		// Blocks start after the header, at the alignment of the block
+		static constexpr std::size_t DataOffset = (sizeof(Header) + alignof(Block) - 1) / alignof(Block) * alignof(Block);
+	public:
+		class iterator;
+		class const_iterator;
+
+		// Address space reserved for the file by default, 64 GiB on 64 bit targets and 1 GiB on 32 bit ones.
+		// Only reserved, so it costs no memory.
+		static constexpr std::size_t DefaultMaxBytes = sizeof(std::size_t) >= 8 ? static_cast<std::size_t>(std::uint64_t(1) << 36) : std::size_t(1) << 30;
+
+		PersistentPool() noexcept
+			: fd(-1)
+			, base(nullptr)
+			, reserved(0)
+			, mapped(0)
+			, top(nullptr)
+			, count(0)
+		{}
+		// Open or create the pool file at path, check is_open() for the result.
+		explicit PersistentPool(const char* path, std::size_t max_bytes = DefaultMaxBytes)
+			: PersistentPool()
+		{
+			open(path, max_bytes);
+		}
+		PersistentPool(const PersistentPool&) = delete;
+		PersistentPool& operator=(const PersistentPool&) = delete;
+
+		PersistentPool(PersistentPool&& other) noexcept
+			: fd(other.fd)
+			, base(other.base)
+			, reserved(other.reserved)
+			, mapped(other.mapped)
+			, freeList(std::move(other.freeList))
+			, top(other.top)
+			, count(other.count)
+		{
+			other.fd = -1;
+			other.base = nullptr;
+			other.reserved = 0;
+			other.mapped = 0;
+			other.freeList.clear();
+			other.top = nullptr;
+			other.count = 0;
+		}
+		PersistentPool& operator=(PersistentPool&& other) noexcept {
+			PersistentPool copy(std::move(other));
+			swap(copy);
+			return *this;
+		}
+		~PersistentPool() {
+			close();
+		}
+
+		// Open the pool file at path, creating it when it does not exist yet. Any file already open is closed first.
+		// max_bytes bounds the size the file can grow to while it is open.
+		// Returns false if the file cannot be opened or mapped, or was written with a different layout.
+		bool open(const char* path, std::size_t max_bytes = DefaultMaxBytes) {
+			close();
+
+			fd = ::open(path, O_RDWR | O_CREAT, 0644);
+			if (fd == -1) {
+				return false;
+			}
+
+			struct stat info;
+			if (fstat(fd, &info) != 0) {
+				close();
+				return false;
+			}
+			std::size_t fileBytes = static_cast<std::size_t>(info.st_size);
+			bool fresh = fileBytes == 0;
+			if (fresh) {
+				fileBytes = DataOffset;
+				if (ftruncate(fd, static_cast<off_t>(fileBytes)) != 0) {
+					close();
+					return false;
+				}
+			}
+			else if (fileBytes < DataOffset || fileBytes > max_bytes) {
+				close();
+				return false;
+			}
+
+			// Reserve the whole range, then map the file over the start of it
+			void* mem = mmap(nullptr, max_bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+			if (mem == MAP_FAILED) {
+				close();
+				return false;
+			}
+			base = static_cast<unsigned char*>(mem);
+			reserved = max_bytes;
+			if (!mapFile(fileBytes)) {
+				close();
+				return false;
+			}
+
+			Header* head = header();
+			if (fresh) {
+				head->magic = Magic;
+				head->version = Version;
+				head->dataOffset = static_cast<std::uint32_t>(DataOffset);
+				head->objectSize = sizeof(T);
+				head->objectAlign = alignof(T);
+				head->blockSize = BlockSize;
+				head->blockBytes = sizeof(Block);
+				head->blocks = 0;
+			}
+			else if (!compatible(*head, fileBytes)) {
+				close();
+				return false;
+			}
+
+			// Only the block headers are read here, never the objects
+			for (Block* block = firstBlock(); block != lastBlock(); ++block) {
+				count += static_cast<std::ptrdiff_t>(block->size());
+				if (block->numFree != 0) {
+					freeList.push_back(block);
+				}
+			}
+			top = freeList.empty() ? nullptr : freeList.back();
+			return true;
+		}
+
+		bool is_open() const noexcept {
+			return base != nullptr;
+		}
+
+		// Unmap and close the file. The objects stay in the file, flush() first to make sure they reach the disk.
+		void close() noexcept {
+			if (base != nullptr) {
+				intern::asanUnpoison(base, mapped);
+				munmap(base, reserved);
+			}
+			if (fd != -1) {
+				::close(fd);
+			}
+			fd = -1;
+			base = nullptr;
+			reserved = 0;
+			mapped = 0;
+			freeList.clear();
+			top = nullptr;
+			count = 0;
+		}
+
+		// Write the modified pages back to the file and wait for them. Returns false on an I/O error.
+		bool flush() noexcept {
+			if (base == nullptr) {
+				return false;
+			}
+			return msync(base, mapped, MS_SYNC) == 0;
+		}
+
+		// Returns nullptr if cannot allocate
+		T* alloc() {
+			if (top == nullptr) {
+				if (!grow(1)) {
+					return nullptr;
+				}
+			}
+
+			Block* block = top;
+			T* obj = block->alloc();
+			if (block->numFree == 0) {
+				freeList.pop_back();
+				top = freeList.empty() ? nullptr : freeList.back();
+			}
+			++count;
+			return obj;
+		}
+		void free(T* obj) {
+#if defined(EZ_POOL_HARDENED)
+			if (!contains(obj) || (reinterpret_cast<std::uintptr_t>(obj) - reinterpret_cast<std::uintptr_t>(owner(obj)->basePtr())) % sizeof(T) != 0) {
+				intern::reportViolation(PoolViolation::ForeignPointer, obj);
+				return;
+			}
+			Block* block = owner(obj);
+			if (!block->isAllocated(obj)) {
+				intern::reportViolation(PoolViolation::DoubleFree, obj);
+				return;
+			}
+#else
+			assert(contains(obj) && "The object was not allocated from this pool!");
+			Block* block = owner(obj);
+			assert(block->isAllocated(obj) && "The object has already been freed!");
+#endif
+
+			block->free(obj);
+			if (block->numFree == 1) {
+				freeList.push_back(block);
+				top = block;
+			}
+			--count;
+		}
+
+		// forwards parameters to object constructor
+		template<typename ... Ts>
+		T* create(Ts&&... args) {
+			T* obj = alloc();
+			if (obj == nullptr) {
+				return obj;
+			}
+			new (obj) T{ std::forward<Ts>(args)... };
+			return obj;
+		}
+		// Persistable types need no destructor call, destroy is free under the name the other pools use.
+		void destroy(T* obj) {
+			assert(obj != nullptr);
+			free(obj);
+		}
+
+		// Free every object, keeping the blocks and the size of the file.
+		void clear() {
+			freeList.clear();
+			for (Block* block = firstBlock(); block != lastBlock(); ++block) {
+				block->clear();
+				freeList.push_back(block);
+			}
+			top = freeList.empty() ? nullptr : freeList.back();
+			count = 0;
+		}
+
+		// attempt to reserve storage for 'cap' elements. Automatically rounds up to multiple of BlockSize
+		// Returns false if the file could not grow that far.
+		bool reserve(std::size_t cap) {
+			std::size_t blocks = (cap + BlockSize - 1) / BlockSize;
+			std::size_t current = numBlocks();
+			return blocks <= current || grow(blocks - current);
+		}
+
+		// Total object capacity available
+		std::ptrdiff_t capacity() const noexcept {
+			return static_cast<std::ptrdiff_t>(numBlocks() * BlockSize);
+		}
+		// Total number of object allocations
+		std::ptrdiff_t size() const noexcept {
+			return count;
+		}
+		bool empty() const noexcept {
+			return count == 0;
+		}
+
+		// Bytes of the file currently mapped
+		std::size_t file_size() const noexcept {
+			return mapped;
+		}
+		std::size_t max_bytes() const noexcept {
+			return reserved;
+		}
+
+		// Is the pointer inside one of the blocks of the pool, found from its address alone
+		bool contains(const T* obj) const noexcept {
+			if (base == nullptr) {
+				return false;
+			}
+			std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(obj);
+			std::uintptr_t first = reinterpret_cast<std::uintptr_t>(firstBlock());
+			std::uintptr_t last = reinterpret_cast<std::uintptr_t>(lastBlock());
+			if (addr < first || addr >= last) {
+				return false;
+			}
+			return Block::contains(owner(obj), obj);
+		}
+
+		iterator begin() noexcept {
+			return iterator(firstBlock(), lastBlock());
+		}
+		iterator end() noexcept {
+			return iterator(lastBlock(), lastBlock());
+		}
+
+		const_iterator begin() const noexcept {
+			return const_iterator(firstBlock(), lastBlock());
+		}
+		const_iterator end() const noexcept {
+			return const_iterator(lastBlock(), lastBlock());
+		}
+
+		const_iterator cbegin() const noexcept {
+			return begin();
+		}
+		const_iterator cend() const noexcept {
+			return end();
+		}
+
+		void swap(PersistentPool& other) noexcept {
+			std::swap(fd, other.fd);
+			std::swap(base, other.base);
+			std::swap(reserved, other.reserved);
+			std::swap(mapped, other.mapped);
+			freeList.swap(other.freeList);
+			std::swap(top, other.top);
+			std::swap(count, other.count);
+		}
+	private:
+		int fd;
+		// Start of the reserved range, the file is mapped at its beginning
+		unsigned char* base;
+		std::size_t reserved, mapped;
+
+		// Blocks with openings, the last one is the top
+		std::vector<Block*> freeList;
+		Block* top;
+		std::ptrdiff_t count;
+
+		Header* header() const noexcept {
+			return reinterpret_cast<Header*>(base);
+		}
+		std::size_t numBlocks() const noexcept {
+			return base == nullptr ? 0 : static_cast<std::size_t>(header()->blocks);
+		}
+		Block* firstBlock() const noexcept {
+			return reinterpret_cast<Block*>(base + DataOffset);
+		}
+		Block* lastBlock() const noexcept {
+			return firstBlock() + numBlocks();
+		}
+		// The blocks are contiguous, so the owner is found by dividing the offset
+		Block* owner(const T* obj) const noexcept {
+			std::size_t offset = static_cast<std::size_t>(reinterpret_cast<const unsigned char*>(obj) - reinterpret_cast<const unsigned char*>(firstBlock()));
+			return firstBlock() + offset / sizeof(Block);
+		}
+
+		static bool compatible(const Header& head, std::size_t fileBytes) noexcept {
+			return head.magic == Magic
+				&& head.version == Version
+				&& head.dataOffset == DataOffset
+				&& head.objectSize == sizeof(T)
+				&& head.objectAlign == alignof(T)
+				&& head.blockSize == BlockSize
+				&& head.blockBytes == sizeof(Block)
+				// Divides rather than multiplies, so a corrupt block count cannot wrap around. open() checked fileBytes >= DataOffset.
+				&& head.blocks <= (fileBytes - DataOffset) / sizeof(Block);
+		}
+
+		// Map the first bytes of the file over the reserved range, replacing any earlier mapping
+		bool mapFile(std::size_t bytes) noexcept {
+			void* mem = mmap(base, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+			if (mem == MAP_FAILED) {
+				return false;
+			}
+			mapped = bytes;
+			return true;
+		}
+
+		// Add at least n blocks to the file, doubling the block count when there is room for it.
+		bool grow(std::size_t n) {
+			std::size_t current = numBlocks();
+			std::size_t room = (reserved - DataOffset) / sizeof(Block);
+			if (current + n > room) {
+				return false;
+			}
+			std::size_t blocks = std::max(current * 2, current + n);
+			if (blocks > room) {
+				blocks = current + n;
+			}
+
+			std::size_t bytes = DataOffset + blocks * sizeof(Block);
+			if (ftruncate(fd, static_cast<off_t>(bytes)) != 0 || !mapFile(bytes)) {
+				return false;
+			}
+
+			// The new blocks are pushed so the first of them ends up on top
+			for (std::size_t i = blocks; i-- > current;) {
+				freeList.push_back(new (firstBlock() + i) Block{});
+			}
+			header()->blocks = blocks;
+			top = freeList.back();
+			return true;
+		}
+	public:
+		// Visits every allocated object, in file order.
+		template<typename B, typename U>
+		class iterator_impl {
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = U;
+			using reference = value_type&;
+			using pointer = value_type*;
+			using difference_type = std::ptrdiff_t;
+
+			iterator_impl() noexcept
+				: block(nullptr)
+				, last(nullptr)
+				, index(0)
+			{}
+			// Iterators convert to const iterators
+			template<typename OtherB, typename OtherU, typename = std::enable_if_t<std::is_convertible_v<OtherB*, B*>>>
+			iterator_impl(const iterator_impl<OtherB, OtherU>& other) noexcept
+				: block(other.block)
+				, last(other.last)
+				, index(other.index)
+			{}
+
+			iterator_impl& operator++() noexcept {
+				index = block->nextAllocated(index + 1);
+				if (index == BlockSize) {
+					nextBlock(block + 1);
+				}
+				return *this;
+			}
+			iterator_impl operator++(int) noexcept {
+				iterator_impl copy = *this;
+				++(*this);
+				return copy;
+			}
+
+			bool operator==(const iterator_impl& other) const noexcept {
+				return block == other.block && index == other.index;
+			}
+			bool operator!=(const iterator_impl& other) const noexcept {
+				return !(*this == other);
+			}
+
+			reference operator*() const noexcept {
+				return block->data[index].object;
+			}
+			pointer operator->() const noexcept {
+				return &block->data[index].object;
+			}
+		protected:
+			friend class PersistentPool;
+			template<typename, typename>
+			friend class iterator_impl;
+
+			B* block, * last;
+			int index;
+
+			iterator_impl(B* first, B* _last) noexcept
+				: last(_last)
+			{
+				nextBlock(first);
+			}
+
+			// Move to the first allocated object of block, skipping empty blocks. Ends at last with index zero.
+			void nextBlock(B* next) noexcept {
+				for (block = next; block != last; ++block) {
+					index = block->nextAllocated(0);
+					if (index != BlockSize) {
+						return;
+					}
+				}
+				index = 0;
+			}
+		};
+
+		class iterator : public iterator_impl<Block, T> {
+		public:
+			iterator() noexcept = default;
+		private:
+			friend class PersistentPool;
+			iterator(Block* first, Block* last) noexcept
+				: iterator_impl<Block, T>(first, last)
+			{}
+		};
+
+		class const_iterator : public iterator_impl<const Block, const T> {
+		public:
+			const_iterator() noexcept = default;
+			const_iterator(const iterator& other) noexcept
+				: iterator_impl<const Block, const T>(other)
+			{}
+		private:
+			friend class PersistentPool;
+			const_iterator(const Block* first, const Block* last) noexcept
+				: iterator_impl<const Block, const T>(first, last)
+			{}
+		};
+	};
+};
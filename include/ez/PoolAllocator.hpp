@@ -0,0 +1,155 @@
+#pragma once
+#include <new>
+#include <memory>
+#include <vector>
+#include <cinttypes>
+#include <type_traits>
+#include <cassert>
+#include "MemoryPool.hpp"
+#include "intern/Storage.hpp"
+
+namespace ez {
+	namespace intern {
+		// The pools shared by a PoolAllocator and all of its copies and rebinds, one for each object size used.
+		template<std::size_t BlockSize>
+		class AllocatorPools {
+		public:
+			template<std::size_t Size, std::size_t Align>
+			using pool_t = MemoryPool<Storage<Size, Align>, BlockSize>;
+
+			AllocatorPools() = default;
+			AllocatorPools(const AllocatorPools&) = delete;
+			AllocatorPools& operator=(const AllocatorPools&) = delete;
+			~AllocatorPools() {
+				for (const Entry& entry : entries) {
+					entry.destroy(entry.pool);
+				}
+			}
+
+			// The pool for objects of the size and alignment, or nullptr if none was created yet
+			template<std::size_t Size, std::size_t Align>
+			pool_t<Size, Align>* find() const noexcept {
+				for (const Entry& entry : entries) {
+					if (entry.size == Size && entry.align == Align) {
+						return static_cast<pool_t<Size, Align>*>(entry.pool);
+					}
+				}
+				return nullptr;
+			}
+
+			// The pool for objects of the size and alignment, created on first use
+			template<std::size_t Size, std::size_t Align>
+			pool_t<Size, Align>* get() {
+				if (pool_t<Size, Align>* pool = find<Size, Align>()) {
+					return pool;
+				}
+
+				std::unique_ptr<pool_t<Size, Align>> pool(new pool_t<Size, Align>{});
+				entries.push_back(Entry{ Size, Align, pool.get(), [](void* ptr) {
+					delete static_cast<pool_t<Size, Align>*>(ptr);
+				} });
+				return pool.release();
+			}
+		private:
+			struct Entry {
+				std::size_t size, align;
+				void* pool;
+				void(*destroy)(void*);
+			};
+			std::vector<Entry> entries;
+		};
+	};
+
+	/*
+	Standard allocator that takes single objects from a pool, for node based containers like std::list, std::map and std::unordered_map.
+	Every copy and rebind of an allocator shares the same set of pools, one per object size, so nodes can be freed through any of them.
+	A default constructed allocator starts a new set of pools, which lives until the last allocator sharing it is destroyed.
+	Requests for more than one object, such as the bucket array of an unordered_map, go to operator new.
+	A rebound allocator creates its pool on its first allocation, so copying and rebinding never throw.
+	Like the pools themselves it is not thread safe.
+	*/
+	template<typename T, std::size_t BlockSize = 256>
+	class PoolAllocator {
+	public:
+		using value_type = T;
+		using propagate_on_container_copy_assignment = std::true_type;
+		using propagate_on_container_move_assignment = std::true_type;
+		using propagate_on_container_swap = std::true_type;
+		using is_always_equal = std::false_type;
+
+		template<typename U>
+		struct rebind {
+			using other = PoolAllocator<U, BlockSize>;
+		};
+
+		PoolAllocator()
+			: pools(std::make_shared<pools_t>())
+			, pool(pools->template get<sizeof(T), alignof(T)>())
+		{}
+		PoolAllocator(const PoolAllocator& other) noexcept = default;
+		template<typename U>
+		PoolAllocator(const PoolAllocator<U, BlockSize>& other) noexcept
+			: pools(other.pools)
+			, pool(pools->template find<sizeof(T), alignof(T)>())
+		{}
+		PoolAllocator& operator=(const PoolAllocator& other) noexcept = default;
+
+		T* allocate(std::size_t n) {
+			if (n == 1) {
+				if (pool == nullptr) {
+					pool = pools->template get<sizeof(T), alignof(T)>();
+				}
+				void* mem = pool->alloc();
+				if (mem == nullptr) {
+					throw std::bad_alloc{};
+				}
+				return static_cast<T*>(mem);
+			}
+			if (n > static_cast<std::size_t>(-1) / sizeof(T)) {
+				throw std::bad_array_new_length{};
+			}
+			if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+				return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{ alignof(T) }));
+			}
+			else {
+				return static_cast<T*>(::operator new(n * sizeof(T)));
+			}
+		}
+		void deallocate(T* ptr, std::size_t n) noexcept {
+			if (n == 1) {
+				// The object came from an equal allocator, so the pool exists even if this one never allocated
+				if (pool == nullptr) {
+					pool = pools->template find<sizeof(T), alignof(T)>();
+					assert(pool != nullptr && "The object was not allocated by an equal allocator!");
+				}
+				pool->free(reinterpret_cast<storage_t*>(ptr));
+				return;
+			}
+			if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+				::operator delete(ptr, std::align_val_t{ alignof(T) });
+			}
+			else {
+				::operator delete(ptr);
+			}
+		}
+
+		template<typename U>
+		bool operator==(const PoolAllocator<U, BlockSize>& other) const noexcept {
+			return pools == other.pools;
+		}
+		template<typename U>
+		bool operator!=(const PoolAllocator<U, BlockSize>& other) const noexcept {
+			return pools != other.pools;
+		}
+	private:
+		template<typename U, std::size_t>
+		friend class PoolAllocator;
+
+		using pools_t = intern::AllocatorPools<BlockSize>;
+		using storage_t = intern::Storage<sizeof(T), alignof(T)>;
+
+		std::shared_ptr<pools_t> pools;
+		// The pool for objects of type T, cached so allocation never searches. nullptr until first needed.
+		typename pools_t::template pool_t<sizeof(T), alignof(T)>* pool;
+	};
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <new>
+#include <cstddef>
+#include <memory_resource>
+#include "MemoryPool.hpp"
+#include "intern/Storage.hpp"
+
+namespace ez {
+	/*
+	Polymorphic memory resource that serves requests of at most Size bytes and Align alignment from a pool,
+	and forwards everything else to the upstream resource.
+	It suits the node allocations of std::pmr containers, whose nodes all have the same size.
+	Like the pools themselves it is not thread safe.
+	*/
+	template<std::size_t Size, std::size_t Align = alignof(std::max_align_t), std::size_t BlockSize = 256>
+	class PoolResource : public std::pmr::memory_resource {
+	public:
+		using pool_t = MemoryPool<intern::Storage<Size, Align>, BlockSize>;
+
+		PoolResource() noexcept
+			: upstream(std::pmr::get_default_resource())
+		{}
+		explicit PoolResource(std::pmr::memory_resource* _upstream) noexcept
+			: upstream(_upstream)
+		{}
+		PoolResource(const PoolResource&) = delete;
+		PoolResource& operator=(const PoolResource&) = delete;
+
+		std::pmr::memory_resource* upstream_resource() const noexcept {
+			return upstream;
+		}
+
+		// The pool serving the small requests
+		const pool_t& pool() const noexcept {
+			return mpool;
+		}
+
+		// Release the pool blocks with no allocations left
+		void shrink() {
+			mpool.shrink();
+		}
+	protected:
+		void* do_allocate(std::size_t bytes, std::size_t align) override {
+			if (pooled(bytes, align)) {
+				void* mem = mpool.alloc();
+				if (mem == nullptr) {
+					throw std::bad_alloc{};
+				}
+				return mem;
+			}
+			return upstream->allocate(bytes, align);
+		}
+		void do_deallocate(void* ptr, std::size_t bytes, std::size_t align) override {
+			if (pooled(bytes, align)) {
+				mpool.free(static_cast<intern::Storage<Size, Align>*>(ptr));
+			}
+			else {
+				upstream->deallocate(ptr, bytes, align);
+			}
+		}
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+			return this == &other;
+		}
+	private:
+		std::pmr::memory_resource* upstream;
+		pool_t mpool;
+
+		static constexpr bool pooled(std::size_t bytes, std::size_t align) noexcept {
+			return bytes <= Size && align <= Align;
+		}
+	};
+};
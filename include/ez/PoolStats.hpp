@@ -0,0 +1,154 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <utility>
+#include <type_traits>
+#include <cinttypes>
+#include <cstddef>
+
+namespace ez {
+	// Point in time view of a pool, as returned by snapshot().
+	struct PoolSnapshot {
+		static constexpr std::size_t OccupancyBins = 10;
+
+		// Event counters, these stay zero unless the pool collects statistics
+		std::uint64_t allocs = 0;
+		std::uint64_t frees = 0;
+		std::uint64_t blocksCreated = 0;
+		std::uint64_t blocksDestroyed = 0;
+		// High water marks of the object and block counts
+		std::uint64_t peakSize = 0;
+		std::uint64_t peakBlocks = 0;
+
+		// Current state, always filled in
+		std::size_t size = 0;
+		std::size_t capacity = 0;
+		std::size_t blocks = 0;
+		// Length of the list of blocks with free slots
+		std::size_t freeBlocks = 0;
+		// Empty blocks whose pages were released by trim(), they are reused before new blocks are created
+		std::size_t idleBlocks = 0;
+		// Bytes taken by the blocks themselves
+		std::size_t blockBytes = 0;
+		// Approximate bytes taken by the block map and the free list
+		std::size_t indexBytes = 0;
+
+		// Number of blocks by fraction of slots in use, bin i holds occupancies in [i / OccupancyBins, (i + 1) / OccupancyBins).
+		// Full blocks are counted in the last bin.
+		std::array<std::size_t, OccupancyBins> occupancy{};
+	};
+
+	// Statistics policy that collects nothing, every hook compiles away.
+	class NoStats {
+	public:
+		static constexpr bool enabled = false;
+
+		void onAlloc(std::size_t) noexcept {}
+		void onFree(std::size_t) noexcept {}
+		void onBlockCreate() noexcept {}
+		void onBlockDestroy(std::size_t) noexcept {}
+
+		void fill(PoolSnapshot&) const noexcept {}
+	};
+
+	/*
+	Statistics policy that counts allocations and block events.
+	Only the pool's own thread updates the counters, so each update is a relaxed load and store rather than an atomic add.
+	That costs about as much as a plain increment, while still letting another thread take snapshots.
+	*/
+	class PoolStats {
+	public:
+		static constexpr bool enabled = true;
+
+		PoolStats() noexcept = default;
+		PoolStats(PoolStats&& other) noexcept {
+			copyFrom(other);
+			other.reset();
+		}
+		PoolStats& operator=(PoolStats&& other) noexcept {
+			copyFrom(other);
+			other.reset();
+			return *this;
+		}
+
+		void onAlloc(std::size_t n) noexcept {
+			std::uint64_t total = bump(allocs, n);
+			std::uint64_t live = total - frees.load(std::memory_order_relaxed);
+			if (live > peakSize.load(std::memory_order_relaxed)) {
+				peakSize.store(live, std::memory_order_relaxed);
+			}
+		}
+		void onFree(std::size_t n) noexcept {
+			bump(frees, n);
+		}
+		void onBlockCreate() noexcept {
+			std::uint64_t total = bump(blocksCreated, 1);
+			std::uint64_t live = total - blocksDestroyed.load(std::memory_order_relaxed);
+			if (live > peakBlocks.load(std::memory_order_relaxed)) {
+				peakBlocks.store(live, std::memory_order_relaxed);
+			}
+		}
+		void onBlockDestroy(std::size_t n) noexcept {
+			bump(blocksDestroyed, n);
+		}
+
+		void fill(PoolSnapshot& snap) const noexcept {
+			snap.allocs = allocs.load(std::memory_order_relaxed);
+			snap.frees = frees.load(std::memory_order_relaxed);
+			snap.blocksCreated = blocksCreated.load(std::memory_order_relaxed);
+			snap.blocksDestroyed = blocksDestroyed.load(std::memory_order_relaxed);
+			snap.peakSize = peakSize.load(std::memory_order_relaxed);
+			snap.peakBlocks = peakBlocks.load(std::memory_order_relaxed);
+		}
+
+		void swap(PoolStats& other) noexcept {
+			PoolStats copy(std::move(other));
+			other.copyFrom(*this);
+			copyFrom(copy);
+		}
+	private:
+		std::atomic<std::uint64_t> allocs{ 0 }, frees{ 0 };
+		std::atomic<std::uint64_t> blocksCreated{ 0 }, blocksDestroyed{ 0 };
+		std::atomic<std::uint64_t> peakSize{ 0 }, peakBlocks{ 0 };
+
+		static std::uint64_t bump(std::atomic<std::uint64_t>& counter, std::size_t n) noexcept {
+			std::uint64_t value = counter.load(std::memory_order_relaxed) + n;
+			counter.store(value, std::memory_order_relaxed);
+			return value;
+		}
+
+		void copyFrom(const PoolStats& other) noexcept {
+			allocs.store(other.allocs.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			frees.store(other.frees.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			blocksCreated.store(other.blocksCreated.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			blocksDestroyed.store(other.blocksDestroyed.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			peakSize.store(other.peakSize.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			peakBlocks.store(other.peakBlocks.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+		void reset() noexcept {
+			allocs.store(0, std::memory_order_relaxed);
+			frees.store(0, std::memory_order_relaxed);
+			blocksCreated.store(0, std::memory_order_relaxed);
+			blocksDestroyed.store(0, std::memory_order_relaxed);
+			peakSize.store(0, std::memory_order_relaxed);
+			peakBlocks.store(0, std::memory_order_relaxed);
+		}
+	};
+
+	namespace intern {
+		template<typename Map, typename = void>
+		struct HasBuckets : std::false_type {};
+		template<typename Map>
+		struct HasBuckets<Map, std::void_t<decltype(std::declval<const Map&>().bucket_count())>> : std::true_type {};
+
+		// Approximate heap usage of a node based map: one node per entry, plus the bucket array of hash maps.
+		template<typename Map>
+		std::size_t mapBytes(const Map& map) noexcept {
+			std::size_t bytes = map.size() * (sizeof(typename Map::value_type) + 2 * sizeof(void*));
+			if constexpr (HasBuckets<Map>::value) {
+				bytes += map.bucket_count() * sizeof(void*);
+			}
+			return bytes;
+		}
+	};
+};
@@ -0,0 +1,205 @@
+#pragma once
+#include <new>
+#include <array>
+#include <tuple>
+#include <utility>
+#include <iterator>
+#include <cinttypes>
+#include <cstddef>
+#include <cassert>
+#include <memory_resource>
+#include "MemoryPool.hpp"
+#include "intern/Storage.hpp"
+
+namespace ez {
+	namespace intern {
+		// Slot sizes of the size classes, spaced so that rounding up wastes at most about 20% past 128 bytes
+		inline constexpr std::size_t SizeClasses[] = {
+			8, 16, 24, 32, 48, 64, 80, 96, 112, 128,
+			160, 192, 224, 256, 320, 384, 448, 512,
+			640, 768, 896, 1024
+		};
+
+		// Alignment of a size class: the largest power of two dividing its size, up to that of max_align_t
+		constexpr std::size_t classAlign(std::size_t size) noexcept {
+			std::size_t align = size & (~size + 1);
+			return align < alignof(std::max_align_t) ? align : alignof(std::max_align_t);
+		}
+
+		// Slots per block of a class, about blockBytes worth but at least 8
+		constexpr std::size_t classSlots(std::size_t size, std::size_t blockBytes) noexcept {
+			return blockBytes / size < 8 ? 8 : blockBytes / size;
+		}
+
+		constexpr std::size_t NumSizeClasses = std::size(SizeClasses);
+		constexpr std::size_t MaxClassSize = SizeClasses[NumSizeClasses - 1];
+
+		// Smallest class of at least 8 * i bytes, for every i up to MaxClassSize / 8
+		constexpr std::array<std::uint8_t, MaxClassSize / 8 + 1> makeClassTable() noexcept {
+			std::array<std::uint8_t, MaxClassSize / 8 + 1> table{};
+			std::size_t index = 0;
+			for (std::size_t i = 0; i < table.size(); ++i) {
+				while (SizeClasses[index] < i * 8) {
+					++index;
+				}
+				table[i] = static_cast<std::uint8_t>(index);
+			}
+			return table;
+		}
+		inline constexpr std::array<std::uint8_t, MaxClassSize / 8 + 1> ClassTable = makeClassTable();
+	};
+
+	/*
+	Memory resource for variable sized allocations, with one MemoryPool per size class.
+	A request is rounded up to the smallest class that fits its size and alignment,
+	requests larger than MaxSize or more aligned than max_align_t go to the upstream resource.
+	deallocate() must be passed the same size and alignment as the matching allocate(), the class is found from them.
+
+	Each class aims for blocks of about BlockBytes, with at least 8 slots per block.
+	The class pools are ordinary MemoryPools, so contains() and iteration over the blocks work per class through class_pool<I>().
+	Like the pools themselves it is not thread safe.
+	*/
+	template<std::size_t BlockBytes = 16384>
+	class SizeClassPool : public std::pmr::memory_resource {
+	public:
+		static constexpr std::size_t NumClasses = intern::NumSizeClasses;
+		static constexpr std::size_t MaxSize = intern::MaxClassSize;
+
+		static constexpr std::size_t class_size(std::size_t index) noexcept {
+			return intern::SizeClasses[index];
+		}
+		static constexpr std::size_t class_align(std::size_t index) noexcept {
+			return intern::classAlign(intern::SizeClasses[index]);
+		}
+		// Number of slots in each block of a class
+		static constexpr std::size_t class_block_size(std::size_t index) noexcept {
+			return intern::classSlots(intern::SizeClasses[index], BlockBytes);
+		}
+
+		template<std::size_t I>
+		using class_storage_t = intern::Storage<intern::SizeClasses[I], intern::classAlign(intern::SizeClasses[I])>;
+		template<std::size_t I>
+		using class_pool_t = MemoryPool<class_storage_t<I>, intern::classSlots(intern::SizeClasses[I], BlockBytes)>;
+
+		SizeClassPool() noexcept
+			: upstream(std::pmr::get_default_resource())
+		{}
+		explicit SizeClassPool(std::pmr::memory_resource* _upstream) noexcept
+			: upstream(_upstream)
+		{}
+		SizeClassPool(const SizeClassPool&) = delete;
+		SizeClassPool& operator=(const SizeClassPool&) = delete;
+
+		// Index of the class serving a request, or NumClasses if it goes upstream
+		static std::size_t size_class(std::size_t bytes, std::size_t align = alignof(std::max_align_t)) noexcept {
+			if (bytes > MaxSize || align > alignof(std::max_align_t)) {
+				return NumClasses;
+			}
+			std::size_t index = intern::ClassTable[(bytes + 7) / 8];
+			// Only the 8 and 24 byte classes are less aligned than the classes after them
+			while (class_align(index) < align) {
+				++index;
+			}
+			return index;
+		}
+
+		std::pmr::memory_resource* upstream_resource() const noexcept {
+			return upstream;
+		}
+
+		template<std::size_t I>
+		class_pool_t<I>& class_pool() noexcept {
+			return std::get<I>(pools);
+		}
+		template<std::size_t I>
+		const class_pool_t<I>& class_pool() const noexcept {
+			return std::get<I>(pools);
+		}
+
+		// Is the pointer allocated from one of the classes, checks every class
+		bool contains(const void* ptr) const noexcept {
+			return containsIn(ptr, std::make_index_sequence<NumClasses>{});
+		}
+
+		// Number of live allocations served by the classes
+		std::size_t size() const noexcept {
+			return sizeIn(std::make_index_sequence<NumClasses>{});
+		}
+
+		// Release the blocks with no allocations left, in every class
+		void shrink() {
+			shrinkIn(std::make_index_sequence<NumClasses>{});
+		}
+	protected:
+		void* do_allocate(std::size_t bytes, std::size_t align) override {
+			std::size_t index = size_class(bytes, align);
+			if (index == NumClasses) {
+				return upstream->allocate(bytes, align);
+			}
+			// Dispatch to the class pool through a table, the pools all have different types
+			static constexpr std::array<AllocFn, NumClasses> allocFns = makeAllocFns(std::make_index_sequence<NumClasses>{});
+			void* mem = allocFns[index](*this);
+			if (mem == nullptr) {
+				throw std::bad_alloc{};
+			}
+			return mem;
+		}
+		void do_deallocate(void* ptr, std::size_t bytes, std::size_t align) override {
+			std::size_t index = size_class(bytes, align);
+			if (index == NumClasses) {
+				upstream->deallocate(ptr, bytes, align);
+				return;
+			}
+			static constexpr std::array<FreeFn, NumClasses> freeFns = makeFreeFns(std::make_index_sequence<NumClasses>{});
+			freeFns[index](*this, ptr);
+		}
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+			return this == &other;
+		}
+	private:
+		using AllocFn = void* (*)(SizeClassPool&);
+		using FreeFn = void (*)(SizeClassPool&, void*);
+
+		template<typename Seq>
+		struct PoolTuple;
+		template<std::size_t ... Is>
+		struct PoolTuple<std::index_sequence<Is...>> {
+			using type = std::tuple<class_pool_t<Is>...>;
+		};
+
+		std::pmr::memory_resource* upstream;
+		typename PoolTuple<std::make_index_sequence<NumClasses>>::type pools;
+
+		template<std::size_t I>
+		static void* allocIn(SizeClassPool& self) {
+			return self.class_pool<I>().alloc();
+		}
+		template<std::size_t I>
+		static void freeIn(SizeClassPool& self, void* ptr) {
+			assert(self.class_pool<I>().contains(static_cast<class_storage_t<I>*>(ptr)) && "The size does not match the allocation!");
+			self.class_pool<I>().free(static_cast<class_storage_t<I>*>(ptr));
+		}
+
+		template<std::size_t ... Is>
+		static constexpr std::array<AllocFn, NumClasses> makeAllocFns(std::index_sequence<Is...>) noexcept {
+			return { &allocIn<Is>... };
+		}
+		template<std::size_t ... Is>
+		static constexpr std::array<FreeFn, NumClasses> makeFreeFns(std::index_sequence<Is...>) noexcept {
+			return { &freeIn<Is>... };
+		}
+
+		template<std::size_t ... Is>
+		bool containsIn(const void* ptr, std::index_sequence<Is...>) const noexcept {
+			return (std::get<Is>(pools).contains(static_cast<const class_storage_t<Is>*>(ptr)) || ...);
+		}
+		template<std::size_t ... Is>
+		std::size_t sizeIn(std::index_sequence<Is...>) const noexcept {
+			return (static_cast<std::size_t>(std::get<Is>(pools).size()) + ...);
+		}
+		template<std::size_t ... Is>
+		void shrinkIn(std::index_sequence<Is...>) {
+			(std::get<Is>(pools).shrink(), ...);
+		}
+	};
+};
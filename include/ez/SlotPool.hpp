@@ -0,0 +1,538 @@
+#pragma once
+#include <new>
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <functional>
+#include <type_traits>
+#include <cinttypes>
+#include <cassert>
+#include "intern/MemoryBlock.hpp"
+#include "BlockSource.hpp"
+
+namespace ez {
+	// Reference to an object in a SlotPool. The default handle is null and never resolves.
+	template<typename Id>
+	class SlotHandle {
+	public:
+		using id_type = Id;
+
+		constexpr SlotHandle() noexcept
+			: id(0)
+		{}
+		constexpr explicit SlotHandle(Id _id) noexcept
+			: id(_id)
+		{}
+
+		constexpr Id value() const noexcept {
+			return id;
+		}
+		constexpr explicit operator bool() const noexcept {
+			return id != 0;
+		}
+
+		constexpr bool operator==(const SlotHandle& other) const noexcept {
+			return id == other.id;
+		}
+		constexpr bool operator!=(const SlotHandle& other) const noexcept {
+			return id != other.id;
+		}
+		constexpr bool operator<(const SlotHandle& other) const noexcept {
+			return id < other.id;
+		}
+	private:
+		Id id;
+	};
+
+	/*
+	Object pool that hands out handles instead of pointers.
+	A handle packs the slot index (block index * BlockSize + slot) in its low bits and a generation counter in the rest.
+	64 bit handles use 32 bits for each, 32 bit handles use 20 bits of index and 12 bits of generation.
+
+	Resolving a handle indexes a flat table of blocks, no hashing involved.
+	Every slot has a generation that is bumped when an object is created in it and again when it is destroyed,
+	so live objects have odd generations and a handle to a destroyed object no longer matches.
+	Generations outlive the blocks released by shrink(), but wrap after 2^GenerationBits / 2 reuses of a slot.
+
+	Objects are stored in the same blocks as the MemoryPool, so iteration is just as dense.
+	*/
+	template<typename T, std::size_t BlockSize = 256, typename Id = std::uint64_t, typename Source = NewBlockSource>
+	class SlotPool {
+	private:
+		static_assert(std::is_same_v<Id, std::uint32_t> || std::is_same_v<Id, std::uint64_t>, "Slot handles must be 32 or 64 bit unsigned integers!");
+
+		struct Block : intern::MemoryBlock<T, BlockSize> {
+			// Position in the block table
+			std::uint32_t id;
+		};
+		using block_iterator = typename Block::iterator;
+		using generation_t = std::conditional_t<sizeof(Id) == 4, std::uint16_t, std::uint32_t>;
+	public:
+		using handle_type = SlotHandle<Id>;
+
+		static constexpr int IndexBits = sizeof(Id) == 4 ? 20 : 32;
+		static constexpr int GenerationBits = static_cast<int>(sizeof(Id) * 8) - IndexBits;
+
+		// Maximum number of slots, the pool stops growing at this capacity
+		static constexpr std::size_t MaxSlots = std::size_t(1) << IndexBits;
+		static_assert(BlockSize <= MaxSlots, "The BlockSize is too large for the handle type!");
+
+		class iterator;
+		class const_iterator;
+
+		SlotPool()
+			: head(nullptr)
+			, tail(nullptr)
+			, top(nullptr)
+			, count(0)
+		{}
+		explicit SlotPool(Source _source)
+			: head(nullptr)
+			, tail(nullptr)
+			, top(nullptr)
+			, count(0)
+			, source(std::move(_source))
+		{}
+		SlotPool(const SlotPool&) = delete;
+		SlotPool& operator=(const SlotPool&) = delete;
+
+		SlotPool(SlotPool&& other) noexcept
+			: table(std::move(other.table))
+			, freeIds(std::move(other.freeIds))
+			, generations(std::move(other.generations))
+			, freeList(std::move(other.freeList))
+			, head(other.head)
+			, tail(other.tail)
+			, top(other.top)
+			, count(other.count)
+			, source(std::move(other.source))
+		{
+			other.table.clear();
+			other.freeIds.clear();
+			other.generations.clear();
+			other.freeList.clear();
+			other.head = nullptr;
+			other.tail = nullptr;
+			other.top = nullptr;
+			other.count = 0;
+		}
+		~SlotPool() {
+			destroyAll();
+			releaseAll();
+		}
+
+		SlotPool& operator=(SlotPool&& other) noexcept {
+			SlotPool copy(std::move(other));
+			swap(copy);
+			return *this;
+		}
+
+		// Construct an object from the parameters and return its handle.
+		// Returns a null handle if no block could be allocated.
+		template<typename ... Ts>
+		handle_type create(Ts&&... args) {
+			if (top == nullptr) {
+				top = createBlock();
+				if (top == nullptr) {
+					return handle_type{};
+				}
+				freeList.push_back(top);
+			}
+
+			Block* block = top;
+			T* obj = block->alloc();
+			try {
+				new (obj) T{ std::forward<Ts>(args)... };
+			}
+			catch (...) {
+				block->free(obj);
+				throw;
+			}
+
+			// Block used up completely
+			if (block->numFree == 0) {
+				freeList.pop_back();
+				top = freeList.empty() ? nullptr : freeList.back();
+			}
+			++count;
+
+			std::size_t index = indexOf(block, obj);
+			return makeHandle(index, bumpGeneration(index));
+		}
+
+		// Destroy the object referenced by a handle.
+		// Returns false, touching nothing, if the handle is null, stale or not from this pool.
+		bool destroy(handle_type handle) {
+			T* obj = get(handle);
+			if (obj == nullptr) {
+				return false;
+			}
+
+			std::size_t index = static_cast<std::size_t>(handle.value() & IndexMask);
+			Block* block = table[index / BlockSize];
+			obj->~T();
+			bumpGeneration(index);
+
+			block->free(obj);
+			if (block->numFree == 1) {
+				freeList.push_back(block);
+				top = block;
+			}
+			--count;
+			return true;
+		}
+
+		// Returns nullptr if the handle is null, stale or not from this pool.
+		T* get(handle_type handle) noexcept {
+			Id value = handle.value();
+			std::size_t index = static_cast<std::size_t>(value & IndexMask);
+			generation_t generation = static_cast<generation_t>(value >> IndexBits);
+
+			// Even generations mark free slots
+			if ((generation & 1) == 0 || index >= generations.size() || generations[index] != generation) {
+				return nullptr;
+			}
+			return table[index / BlockSize]->basePtr() + index % BlockSize;
+		}
+		const T* get(handle_type handle) const noexcept {
+			return const_cast<SlotPool*>(this)->get(handle);
+		}
+
+		bool contains(handle_type handle) const noexcept {
+			return get(handle) != nullptr;
+		}
+
+		// Destroy every object, keeping the blocks. Every outstanding handle becomes stale.
+		void clear() {
+			destroyAll();
+			freeList.clear();
+			for (Block* block = head; block != nullptr; block = next(block)) {
+				block->clear();
+				freeList.push_back(block);
+			}
+			top = freeList.empty() ? nullptr : freeList.back();
+			count = 0;
+		}
+
+		// Release the blocks with no live objects. Their slot generations are kept, so handles stay stale.
+		void shrink() {
+			auto iter = freeList.begin();
+			while (iter != freeList.end()) {
+				Block* block = *iter;
+				if (block->empty()) {
+					destroyBlock(block);
+					*iter = freeList.back();
+					freeList.pop_back();
+				}
+				else {
+					++iter;
+				}
+			}
+			top = freeList.empty() ? nullptr : freeList.back();
+		}
+
+		// attempt to reserve storage for 'cap' objects. Automatically rounds up to multiple of BlockSize
+		void reserve(std::size_t cap) {
+			while (capacity() < static_cast<std::ptrdiff_t>(cap)) {
+				Block* block = createBlock();
+				if (block == nullptr) {
+					break;
+				}
+				freeList.push_back(block);
+			}
+			if (!freeList.empty()) {
+				top = freeList.back();
+			}
+		}
+
+		// Total object capacity available
+		std::ptrdiff_t capacity() const noexcept {
+			return static_cast<std::ptrdiff_t>((table.size() - freeIds.size()) * BlockSize);
+		}
+		// Total number of live objects
+		std::ptrdiff_t size() const noexcept {
+			return count;
+		}
+		bool empty() const noexcept {
+			return count == 0;
+		}
+
+		iterator begin() noexcept {
+			return iterator(this, head);
+		}
+		iterator end() noexcept {
+			return iterator();
+		}
+
+		const_iterator begin() const noexcept {
+			return const_iterator(const_cast<SlotPool*>(this)->begin());
+		}
+		const_iterator end() const noexcept {
+			return const_iterator(const_cast<SlotPool*>(this)->end());
+		}
+
+		const_iterator cbegin() const noexcept {
+			return begin();
+		}
+		const_iterator cend() const noexcept {
+			return end();
+		}
+
+		void swap(SlotPool& other) noexcept {
+			table.swap(other.table);
+			freeIds.swap(other.freeIds);
+			generations.swap(other.generations);
+			freeList.swap(other.freeList);
+			std::swap(head, other.head);
+			std::swap(tail, other.tail);
+			std::swap(top, other.top);
+			std::swap(count, other.count);
+			std::swap(source, other.source);
+		}
+
+		Source& get_source() noexcept {
+			return source;
+		}
+		const Source& get_source() const noexcept {
+			return source;
+		}
+	private:
+		static constexpr Id IndexMask = static_cast<Id>(MaxSlots - 1);
+		static constexpr generation_t GenerationMask = static_cast<generation_t>((std::uint64_t(1) << GenerationBits) - 1);
+
+		// Blocks by id, released blocks leave a nullptr until the id is reused
+		std::vector<Block*> table;
+		std::vector<std::uint32_t> freeIds;
+		// Generation of every slot in the table
+		std::vector<generation_t> generations;
+		// List of blocks with openings
+		std::vector<Block*> freeList;
+		// Intrusive list of the live blocks, used for iteration
+		Block* head, * tail;
+		Block* top;
+		std::ptrdiff_t count;
+
+		Source source;
+
+		static Block* next(Block* block) noexcept {
+			return static_cast<Block*>(block->next);
+		}
+
+		static std::size_t indexOf(const Block* block, const T* obj) noexcept {
+			return static_cast<std::size_t>(block->id) * BlockSize + static_cast<std::size_t>(obj - block->basePtr());
+		}
+		static handle_type makeHandle(std::size_t index, generation_t generation) noexcept {
+			return handle_type{ static_cast<Id>((static_cast<Id>(generation) << IndexBits) | static_cast<Id>(index)) };
+		}
+		generation_t bumpGeneration(std::size_t index) noexcept {
+			generation_t generation = static_cast<generation_t>((generations[index] + 1) & GenerationMask);
+			generations[index] = generation;
+			return generation;
+		}
+
+		void destroyAll() noexcept {
+			for (Block* block = head; block != nullptr; block = next(block)) {
+				for (auto iter = block->begin(); iter != block->end(); ++iter) {
+					iter->~T();
+					bumpGeneration(static_cast<std::size_t>(block->id) * BlockSize + iter.getIndex());
+				}
+			}
+		}
+
+		Block* createBlock() {
+			if (freeIds.empty() && (table.size() + 1) * BlockSize > MaxSlots) {
+				return nullptr;
+			}
+
+			// Allocate before taking an id, so a failure leaves the table as it was
+			void* mem = source.allocate(sizeof(Block), alignof(Block));
+			if (mem == nullptr) {
+				return nullptr;
+			}
+
+			std::uint32_t id;
+			if (!freeIds.empty()) {
+				id = freeIds.back();
+				freeIds.pop_back();
+			}
+			else {
+				id = static_cast<std::uint32_t>(table.size());
+				try {
+					table.push_back(nullptr);
+					generations.resize(table.size() * BlockSize, 0);
+				}
+				catch (...) {
+					table.resize(id);
+					source.deallocate(mem, sizeof(Block), alignof(Block));
+					throw;
+				}
+			}
+			Block* block = new (mem) Block{};
+			block->id = id;
+			table[id] = block;
+
+			block->prev = tail;
+			block->next = nullptr;
+			if (tail != nullptr) {
+				tail->next = block;
+			}
+			else {
+				head = block;
+			}
+			tail = block;
+			return block;
+		}
+		void destroyBlock(Block* block) noexcept {
+			if (block->prev != nullptr) {
+				block->prev->next = block->next;
+			}
+			else {
+				head = next(block);
+			}
+			if (block->next != nullptr) {
+				block->next->prev = block->prev;
+			}
+			else {
+				tail = static_cast<Block*>(block->prev);
+			}
+
+			table[block->id] = nullptr;
+			freeIds.push_back(block->id);
+			block->~Block();
+			source.deallocate(block, sizeof(Block), alignof(Block));
+		}
+		void releaseAll() noexcept {
+			Block* block = head;
+			while (block != nullptr) {
+				Block* following = next(block);
+				block->~Block();
+				source.deallocate(block, sizeof(Block), alignof(Block));
+				block = following;
+			}
+			head = nullptr;
+			tail = nullptr;
+		}
+	public:
+		class iterator {
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = T;
+			using reference = value_type&;
+			using pointer = value_type*;
+			using difference_type = std::ptrdiff_t;
+
+			iterator() noexcept
+				: pool(nullptr)
+			{}
+
+			iterator& operator++() noexcept {
+				++blockIter;
+				if (blockIter.atEnd()) {
+					nextBlock(next(static_cast<Block*>(blockIter.getBlock())));
+				}
+				return *this;
+			}
+			iterator operator++(int) noexcept {
+				iterator copy = *this;
+				++(*this);
+				return copy;
+			}
+
+			bool operator==(const iterator& other) const noexcept {
+				return (blockIter.getBlock() == other.blockIter.getBlock()) && (blockIter == other.blockIter);
+			}
+			bool operator!=(const iterator& other) const noexcept {
+				return !(*this == other);
+			}
+
+			reference operator*() noexcept {
+				return *blockIter;
+			}
+			pointer operator->() noexcept {
+				return &*blockIter;
+			}
+
+			// Handle of the current object
+			handle_type handle() const noexcept {
+				std::size_t index = static_cast<std::size_t>(static_cast<Block*>(blockIter.getBlock())->id) * BlockSize + blockIter.getIndex();
+				return makeHandle(index, pool->generations[index]);
+			}
+		private:
+			friend class SlotPool;
+			SlotPool* pool;
+			block_iterator blockIter;
+
+			iterator(SlotPool* _pool, Block* block) noexcept
+				: pool(_pool)
+			{
+				nextBlock(block);
+			}
+
+			// Move to the first live object of block, skipping empty blocks.
+			void nextBlock(Block* block) noexcept {
+				while (block != nullptr) {
+					int index = block->nextAllocated(0);
+					if (index != BlockSize) {
+						blockIter = block_iterator(block, index);
+						return;
+					}
+					block = next(block);
+				}
+				blockIter = block_iterator{};
+			}
+		}; // End iterator
+
+		class const_iterator {
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = const T;
+			using reference = value_type&;
+			using pointer = value_type*;
+			using difference_type = std::ptrdiff_t;
+
+			const_iterator() noexcept = default;
+			const_iterator(const iterator& other) noexcept
+				: _inner(other)
+			{}
+
+			const_iterator& operator++() noexcept {
+				++_inner;
+				return *this;
+			}
+			const_iterator operator++(int) noexcept {
+				const_iterator copy = *this;
+				++(*this);
+				return copy;
+			}
+
+			bool operator==(const const_iterator& other) const noexcept {
+				return _inner == other._inner;
+			}
+			bool operator!=(const const_iterator& other) const noexcept {
+				return _inner != other._inner;
+			}
+
+			reference operator*() noexcept {
+				return *_inner;
+			}
+			pointer operator->() noexcept {
+				return &*_inner;
+			}
+
+			handle_type handle() const noexcept {
+				return _inner.handle();
+			}
+		private:
+			iterator _inner;
+		};
+	};
+};
+
+namespace std {
+	template<typename Id>
+	struct hash<ez::SlotHandle<Id>> {
+		std::size_t operator()(const ez::SlotHandle<Id>& handle) const noexcept {
+			return std::hash<Id>{}(handle.value());
+		}
+	};
+};
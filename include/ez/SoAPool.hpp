@@ -0,0 +1,416 @@
+#pragma once
+#include <new>
+#include <tuple>
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <type_traits>
+#include <cinttypes>
+#include <cassert>
+#include "intern/SoABlock.hpp"
+#include "BlockSource.hpp"
+
+namespace ez {
+	/*
+	Pool of rows made of several fields, stored as a structure of arrays.
+	Every block holds one contiguous array per field, plus the occupancy bitmap of its slots,
+	so a pass over a single field only loads that field, and a kernel over a block's arrays can be vectorized.
+
+	A row refers to its block and slot index, and stays valid until it is destroyed.
+	blocks() exposes each block's field arrays and occupancy mask directly.
+	Arrays of trivially copyable fields are zeroed when their block is created, so every slot of them holds a valid value.
+	Kernels over such fields may then process whole blocks and select the live slots with the mask afterwards.
+	*/
+	template<std::size_t BlockSize, typename Source, typename ... Fields>
+	class BasicSoAPool {
+	private:
+		using Block = intern::SoABlock<BlockSize, Fields...>;
+	public:
+		using Bitmap = typename Block::Bitmap;
+
+		template<std::size_t I>
+		using field_t = typename Block::template field_t<I>;
+
+		static constexpr std::size_t NumFields = sizeof...(Fields);
+
+		class row;
+		class block_view;
+		class iterator;
+
+		// Snapshot of the pool's non-empty blocks. It is random access, so it can be split between threads.
+		using block_range = std::vector<block_view>;
+
+		BasicSoAPool()
+			: head(nullptr)
+			, tail(nullptr)
+			, top(nullptr)
+			, count(0)
+			, bcount(0)
+		{}
+		explicit BasicSoAPool(Source _source)
+			: head(nullptr)
+			, tail(nullptr)
+			, top(nullptr)
+			, count(0)
+			, bcount(0)
+			, source(std::move(_source))
+		{}
+		BasicSoAPool(const BasicSoAPool&) = delete;
+		BasicSoAPool& operator=(const BasicSoAPool&) = delete;
+
+		BasicSoAPool(BasicSoAPool&& other) noexcept
+			: freeList(std::move(other.freeList))
+			, head(other.head)
+			, tail(other.tail)
+			, top(other.top)
+			, count(other.count)
+			, bcount(other.bcount)
+			, source(std::move(other.source))
+		{
+			other.freeList.clear();
+			other.head = nullptr;
+			other.tail = nullptr;
+			other.top = nullptr;
+			other.count = 0;
+			other.bcount = 0;
+		}
+		~BasicSoAPool() {
+			releaseAll();
+		}
+
+		BasicSoAPool& operator=(BasicSoAPool&& other) noexcept {
+			BasicSoAPool copy(std::move(other));
+			swap(copy);
+			return *this;
+		}
+
+		// Create a row with every field value initialized.
+		// Returns a null row if no block could be allocated.
+		row create() {
+			return emplace(std::tuple<>{});
+		}
+		// Create a row, constructing each field from the matching value.
+		template<typename ... Ts, typename = std::enable_if_t<sizeof...(Ts) == NumFields && (sizeof...(Ts) > 0)>>
+		row create(Ts&&... values) {
+			return emplace(std::forward_as_tuple(std::forward<Ts>(values)...));
+		}
+
+		void destroy(row pos) {
+			Block* block = pos.block;
+			assert(block != nullptr && block->isAllocated(pos.index) && "The row has already been destroyed!");
+
+			block->destroy(pos.index);
+			block->free(pos.index);
+			if (block->numFree == 1) {
+				freeList.push_back(block);
+				top = block;
+			}
+			--count;
+		}
+
+		// Destroy every row, keeping the blocks.
+		void clear() {
+			freeList.clear();
+			for (Block* block = head; block != nullptr; block = block->next) {
+				block->clear();
+				freeList.push_back(block);
+			}
+			top = freeList.empty() ? nullptr : freeList.back();
+			count = 0;
+		}
+
+		// Release the blocks with no live rows.
+		void shrink() {
+			auto iter = freeList.begin();
+			while (iter != freeList.end()) {
+				Block* block = *iter;
+				if (block->empty()) {
+					destroyBlock(block);
+					*iter = freeList.back();
+					freeList.pop_back();
+				}
+				else {
+					++iter;
+				}
+			}
+			top = freeList.empty() ? nullptr : freeList.back();
+		}
+
+		// attempt to reserve storage for 'cap' rows. Automatically rounds up to multiple of BlockSize
+		void reserve(std::size_t cap) {
+			while (capacity() < static_cast<std::ptrdiff_t>(cap)) {
+				Block* block = createBlock();
+				if (block == nullptr) {
+					break;
+				}
+				freeList.push_back(block);
+			}
+			if (!freeList.empty()) {
+				top = freeList.back();
+			}
+		}
+
+		// Total row capacity available
+		std::ptrdiff_t capacity() const noexcept {
+			return bcount * static_cast<std::ptrdiff_t>(BlockSize);
+		}
+		// Total number of live rows
+		std::ptrdiff_t size() const noexcept {
+			return count;
+		}
+		bool empty() const noexcept {
+			return count == 0;
+		}
+
+		block_range blocks() const {
+			block_range range;
+			range.reserve(static_cast<std::size_t>(bcount));
+			for (Block* block = head; block != nullptr; block = block->next) {
+				if (!block->empty()) {
+					range.push_back(block_view(block));
+				}
+			}
+			return range;
+		}
+
+		iterator begin() const noexcept {
+			return iterator(head);
+		}
+		iterator end() const noexcept {
+			return iterator();
+		}
+
+		void swap(BasicSoAPool& other) noexcept {
+			freeList.swap(other.freeList);
+			std::swap(head, other.head);
+			std::swap(tail, other.tail);
+			std::swap(top, other.top);
+			std::swap(count, other.count);
+			std::swap(bcount, other.bcount);
+			std::swap(source, other.source);
+		}
+
+		Source& get_source() noexcept {
+			return source;
+		}
+		const Source& get_source() const noexcept {
+			return source;
+		}
+	private:
+		// List of blocks with openings
+		std::vector<Block*> freeList;
+		// Intrusive list of every block, used for iteration
+		Block* head, * tail;
+		Block* top;
+		std::ptrdiff_t count, bcount;
+
+		Source source;
+
+		template<typename Tuple>
+		row emplace(Tuple&& values) {
+			if (top == nullptr) {
+				top = createBlock();
+				if (top == nullptr) {
+					return row{};
+				}
+				freeList.push_back(top);
+			}
+
+			Block* block = top;
+			int index = block->alloc();
+			try {
+				block->construct(index, std::forward<Tuple>(values));
+			}
+			catch (...) {
+				block->free(index);
+				throw;
+			}
+
+			// Block used up completely
+			if (block->numFree == 0) {
+				freeList.pop_back();
+				top = freeList.empty() ? nullptr : freeList.back();
+			}
+			++count;
+			return row(block, index);
+		}
+
+		Block* createBlock() {
+			void* mem = source.allocate(sizeof(Block), alignof(Block));
+			if (mem == nullptr) {
+				return nullptr;
+			}
+			Block* block = new (mem) Block{};
+
+			block->prev = tail;
+			block->next = nullptr;
+			if (tail != nullptr) {
+				tail->next = block;
+			}
+			else {
+				head = block;
+			}
+			tail = block;
+			++bcount;
+			return block;
+		}
+		void destroyBlock(Block* block) noexcept {
+			if (block->prev != nullptr) {
+				block->prev->next = block->next;
+			}
+			else {
+				head = block->next;
+			}
+			if (block->next != nullptr) {
+				block->next->prev = block->prev;
+			}
+			else {
+				tail = block->prev;
+			}
+
+			block->~Block();
+			source.deallocate(block, sizeof(Block), alignof(Block));
+			--bcount;
+		}
+		void releaseAll() noexcept {
+			Block* block = head;
+			while (block != nullptr) {
+				Block* following = block->next;
+				block->clear();
+				block->~Block();
+				source.deallocate(block, sizeof(Block), alignof(Block));
+				block = following;
+			}
+			head = nullptr;
+			tail = nullptr;
+		}
+	public:
+		// Reference to a live row
+		class row {
+		public:
+			row() noexcept
+				: block(nullptr)
+				, index(0)
+			{}
+
+			explicit operator bool() const noexcept {
+				return block != nullptr;
+			}
+
+			template<std::size_t I>
+			field_t<I>& get() const noexcept {
+				return block->template field<I>()[index];
+			}
+
+			bool operator==(const row& other) const noexcept {
+				return block == other.block && index == other.index;
+			}
+			bool operator!=(const row& other) const noexcept {
+				return !(*this == other);
+			}
+		private:
+			friend class BasicSoAPool;
+			Block* block;
+			int index;
+
+			row(Block* _block, int _index) noexcept
+				: block(_block)
+				, index(_index)
+			{}
+		};
+
+		// The field arrays and occupancy of a single block.
+		class block_view {
+		public:
+			block_view() noexcept
+				: block(nullptr)
+			{}
+			explicit block_view(Block* _block) noexcept
+				: block(_block)
+			{}
+
+			// Array of BlockSize values of field I, only the slots set in mask() are live
+			template<std::size_t I>
+			field_t<I>* field() const noexcept {
+				return block->template field<I>();
+			}
+
+			// Occupancy bitmap, bit i of word i / 64 is set when slot i is live. Bits past BlockSize are zero.
+			const Bitmap& mask() const noexcept {
+				return block->occupied;
+			}
+			bool occupied(std::size_t index) const noexcept {
+				return block->isAllocated(static_cast<int>(index));
+			}
+
+			// Number of live rows in the block
+			std::size_t size() const noexcept {
+				return block->size();
+			}
+			static constexpr std::size_t max_size() noexcept {
+				return BlockSize;
+			}
+		private:
+			Block* block;
+		};
+
+		// Visits every live row, block by block.
+		class iterator {
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = row;
+			using reference = row;
+			using pointer = void;
+			using difference_type = std::ptrdiff_t;
+
+			iterator() noexcept = default;
+
+			iterator& operator++() noexcept {
+				current.index = current.block->nextAllocated(current.index + 1);
+				if (current.index == BlockSize) {
+					nextBlock(current.block->next);
+				}
+				return *this;
+			}
+			iterator operator++(int) noexcept {
+				iterator copy = *this;
+				++(*this);
+				return copy;
+			}
+
+			bool operator==(const iterator& other) const noexcept {
+				return current == other.current;
+			}
+			bool operator!=(const iterator& other) const noexcept {
+				return current != other.current;
+			}
+
+			row operator*() const noexcept {
+				return current;
+			}
+		private:
+			friend class BasicSoAPool;
+			row current;
+
+			explicit iterator(Block* block) noexcept {
+				nextBlock(block);
+			}
+
+			// Move to the first live row of block, skipping empty blocks.
+			void nextBlock(Block* block) noexcept {
+				while (block != nullptr) {
+					int index = block->nextAllocated(0);
+					if (index != BlockSize) {
+						current = row(block, index);
+						return;
+					}
+					block = block->next;
+				}
+				current = row();
+			}
+		};
+	};
+
+	template<typename ... Fields>
+	using SoAPool = BasicSoAPool<256, NewBlockSource, Fields...>;
+};
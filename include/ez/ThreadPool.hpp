@@ -0,0 +1,154 @@
+#pragma once
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <condition_variable>
+#include <cinttypes>
+
+namespace ez {
+	/*
+	Small fixed size thread pool for running a loop in parallel.
+	The calling thread takes part in the work, so a pool of N workers runs a loop on N + 1 threads.
+	Work is handed out one index at a time through an atomic counter, so uneven blocks balance themselves.
+	The loop body must not throw.
+	*/
+	class ThreadPool {
+	public:
+		explicit ThreadPool(std::size_t numWorkers = defaultWorkers())
+			: job(nullptr)
+			, jobData(nullptr)
+			, total(0)
+			, next(0)
+			, generation(0)
+			, running(0)
+			, stopping(false)
+		{
+			workers.reserve(numWorkers);
+			for (std::size_t i = 0; i < numWorkers; ++i) {
+				workers.emplace_back([this]() {
+					work();
+				});
+			}
+		}
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		~ThreadPool() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			wake.notify_all();
+			for (std::thread& worker : workers) {
+				worker.join();
+			}
+		}
+
+		// Number of threads running a loop, including the caller
+		std::size_t concurrency() const noexcept {
+			return workers.size() + 1;
+		}
+
+		// Run fn(i) for every i in [0, count), blocks until every call has returned.
+		template<typename F>
+		void parallel_for(std::size_t count, F&& fn) {
+			if (count == 0) {
+				return;
+			}
+
+			using fn_t = std::remove_reference_t<F>;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				job = [](void* data, std::size_t index) {
+					(*static_cast<fn_t*>(data))(index);
+				};
+				jobData = const_cast<void*>(static_cast<const void*>(&fn));
+				total = count;
+				next.store(0, std::memory_order_relaxed);
+				running = workers.size();
+				++generation;
+			}
+			wake.notify_all();
+
+			runJob(job, jobData, count);
+
+			std::unique_lock<std::mutex> lock(mutex);
+			done.wait(lock, [this]() {
+				return running == 0;
+			});
+			job = nullptr;
+			jobData = nullptr;
+		}
+
+		static std::size_t defaultWorkers() noexcept {
+			unsigned threads = std::thread::hardware_concurrency();
+			return threads > 1 ? threads - 1 : 0;
+		}
+	private:
+		using job_t = void(*)(void*, std::size_t);
+
+		std::vector<std::thread> workers;
+
+		std::mutex mutex;
+		std::condition_variable wake, done;
+
+		// The current loop, protected by the mutex except for next
+		job_t job;
+		void* jobData;
+		std::size_t total;
+		std::atomic<std::size_t> next;
+		std::uint64_t generation;
+		std::size_t running;
+		bool stopping;
+
+		void runJob(job_t fn, void* data, std::size_t count) {
+			for (std::size_t index = next.fetch_add(1, std::memory_order_relaxed); index < count; index = next.fetch_add(1, std::memory_order_relaxed)) {
+				fn(data, index);
+			}
+		}
+
+		void work() {
+			std::uint64_t seen = 0;
+			while (true) {
+				job_t fn;
+				void* data;
+				std::size_t count;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					wake.wait(lock, [&]() {
+						return stopping || generation != seen;
+					});
+					if (stopping) {
+						return;
+					}
+					seen = generation;
+					fn = job;
+					data = jobData;
+					count = total;
+				}
+
+				runJob(fn, data, count);
+
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					--running;
+				}
+				done.notify_one();
+			}
+		}
+	};
+
+	// Run fn on every object in the pool, handing whole blocks to the workers of the thread pool.
+	template<typename Pool, typename F>
+	void for_each(ThreadPool& workers, Pool& pool, F fn) {
+		typename Pool::block_range range = pool.blocks();
+		workers.parallel_for(range.size(), [&](std::size_t index) {
+			for (auto& obj : range[index]) {
+				fn(obj);
+			}
+		});
+	}
+};
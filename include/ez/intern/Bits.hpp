@@ -0,0 +1,106 @@
+#pragma once
+#include <cinttypes>
+#include <cstddef>
+#include <cassert>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ez::intern {
+	// Smallest power of two greater than or equal to value.
+	constexpr std::size_t ceilPow2(std::size_t value) noexcept {
+		std::size_t result = 1;
+		while (result < value) {
+			result <<= 1;
+		}
+		return result;
+	}
+
+	constexpr bool isPow2(std::size_t value) noexcept {
+		return value != 0 && (value & (value - 1)) == 0;
+	}
+
+	// Number of 64 bit words needed to store nbits bits.
+	constexpr std::size_t wordCount(std::size_t nbits) noexcept {
+		return (nbits + 63) / 64;
+	}
+
+	// The value must not be zero.
+	inline int countTrailingZeros(std::uint64_t value) noexcept {
+		assert(value != 0);
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return static_cast<int>(index);
+#else
+		return __builtin_ctzll(value);
+#endif
+	}
+
+	// The value must not be zero.
+	inline int countLeadingZeros(std::uint64_t value) noexcept {
+		assert(value != 0);
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return 63 - static_cast<int>(index);
+#else
+		return __builtin_clzll(value);
+#endif
+	}
+
+	inline int popCount(std::uint64_t value) noexcept {
+#if defined(_MSC_VER)
+		return static_cast<int>(__popcnt64(value));
+#else
+		return __builtin_popcountll(value);
+#endif
+	}
+
+	inline bool testBit(const std::uint64_t* words, std::size_t index) noexcept {
+		return (words[index / 64] >> (index % 64)) & 1;
+	}
+	inline void setBit(std::uint64_t* words, std::size_t index) noexcept {
+		words[index / 64] |= std::uint64_t(1) << (index % 64);
+	}
+	inline void clearBit(std::uint64_t* words, std::size_t index) noexcept {
+		words[index / 64] &= ~(std::uint64_t(1) << (index % 64));
+	}
+
+	// Index of the first set bit at or after index, or nbits if there is none.
+	// Bits past nbits in the last word must be zero.
+	inline int findNextSet(const std::uint64_t* words, int nbits, int index) noexcept {
+		if (index >= nbits) {
+			return nbits;
+		}
+
+		int word = index / 64;
+		std::uint64_t bits = words[word] & (~std::uint64_t(0) << (index % 64));
+		int last = (nbits - 1) / 64;
+		while (bits == 0) {
+			if (word == last) {
+				return nbits;
+			}
+			bits = words[++word];
+		}
+		return word * 64 + countTrailingZeros(bits);
+	}
+
+	// Index of the last set bit at or before index, or -1 if there is none.
+	inline int findPrevSet(const std::uint64_t* words, int index) noexcept {
+		if (index < 0) {
+			return -1;
+		}
+
+		int word = index / 64;
+		std::uint64_t bits = words[word] & (~std::uint64_t(0) >> (63 - (index % 64)));
+		while (bits == 0) {
+			if (word == 0) {
+				return -1;
+			}
+			bits = words[--word];
+		}
+		return word * 64 + 63 - countLeadingZeros(bits);
+	}
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <cinttypes>
+
+#if defined(__SANITIZE_ADDRESS__)
+#define EZ_POOL_ASAN 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define EZ_POOL_ASAN 1
+#endif
+#endif
+
+#if defined(EZ_POOL_ASAN)
+#include <sanitizer/asan_interface.h>
+#endif
+
+namespace ez {
+	// Misuse caught by the checks of a hardened build, see EZ_POOL_HARDENED
+	enum class PoolViolation {
+		// The object was already freed
+		DoubleFree,
+		// The pointer is not an object of the pool, or points inside one
+		ForeignPointer,
+		// A free slot was written to between its free and its next allocation
+		UseAfterFree
+	};
+
+	// Called with the violation and the pointer involved. The default handler prints them and aborts.
+	// A handler that returns lets the pool carry on: the bad free is ignored, the overwritten slot is still handed out.
+	using PoolViolationHandler = void (*)(PoolViolation, const void*);
+
+	namespace intern {
+		// This header is for internal use only
+
+		inline const char* violationName(PoolViolation violation) noexcept {
+			switch (violation) {
+			case PoolViolation::DoubleFree:
+				return "double free";
+			case PoolViolation::ForeignPointer:
+				return "pointer not from this pool";
+			case PoolViolation::UseAfterFree:
+				return "write to a freed slot";
+			}
+			return "unknown violation";
+		}
+
+		inline void abortOnViolation(PoolViolation violation, const void* ptr) noexcept {
+			std::fprintf(stderr, "ez-pool: %s at %p\n", violationName(violation), ptr);
+			std::abort();
+		}
+
+		inline std::atomic<PoolViolationHandler>& violationHandler() noexcept {
+			static std::atomic<PoolViolationHandler> handler{ &abortOnViolation };
+			return handler;
+		}
+
+		inline void reportViolation(PoolViolation violation, const void* ptr) {
+			violationHandler().load(std::memory_order_acquire)(violation, ptr);
+		}
+
+		// Byte written over the free slots of a hardened build
+		constexpr unsigned char PoisonByte = 0xDB;
+
+		// Fill bytes with the poison pattern
+		inline void poisonBytes(void* ptr, std::size_t bytes) noexcept {
+			std::memset(ptr, PoisonByte, bytes);
+		}
+		// Is the poison pattern intact. Compares a word at a time, OR-ing the differences so there is a single branch.
+		inline bool poisonIntact(const void* ptr, std::size_t bytes) noexcept {
+			constexpr std::uint64_t PoisonWord = 0x0101010101010101ull * PoisonByte;
+			const unsigned char* data = static_cast<const unsigned char*>(ptr);
+			std::uint64_t diff = 0;
+			std::size_t i = 0;
+			for (; i + 8 <= bytes; i += 8) {
+				std::uint64_t word;
+				std::memcpy(&word, data + i, 8);
+				diff |= word ^ PoisonWord;
+			}
+			for (; i < bytes; ++i) {
+				diff |= data[i] ^ PoisonByte;
+			}
+			return diff == 0;
+		}
+
+		// Mark memory as unaddressable for AddressSanitizer, no-ops in other builds
+		inline void asanPoison(const void* ptr, std::size_t bytes) noexcept {
+#if defined(EZ_POOL_ASAN)
+			__asan_poison_memory_region(ptr, bytes);
+#else
+			(void)ptr;
+			(void)bytes;
+#endif
+		}
+		inline void asanUnpoison(const void* ptr, std::size_t bytes) noexcept {
+#if defined(EZ_POOL_ASAN)
+			__asan_unpoison_memory_region(ptr, bytes);
+#else
+			(void)ptr;
+			(void)bytes;
+#endif
+		}
+	};
+
+	// Replace the handler of hardened builds, returns the previous one.
+	inline PoolViolationHandler set_violation_handler(PoolViolationHandler handler) noexcept {
+		return intern::violationHandler().exchange(handler != nullptr ? handler : &intern::abortOnViolation);
+	}
+};
@@ -2,26 +2,41 @@
 #include <type_traits>
 #include <cinttypes>
 #include <array>
-#include <bitset>
+#include <iterator>
+#include <algorithm>
 #include <cassert>
+#include "Bits.hpp"
+#include "Hardening.hpp"
 
 namespace ez::intern {
 	// This class is for internal use only
 	template<typename T, std::size_t BlockSize>
 	class MemoryBlock {
 	public:
+		static_assert(BlockSize > 0, "BlockSize must be at least one!");
+
 		static constexpr std::size_t BlockBytes = sizeof(T) * BlockSize;
 
+		// The smallest integer type able to index every slot of the block.
+		// Blocks of 256 slots or less use uint8_t, which guarantees we can store any type, even char.
+		// Larger blocks widen the index, but only when T is large enough to hold it,
+		// otherwise the Memory union would grow past sizeof(T) and waste space in every slot.
+		using index_t = std::conditional_t<(BlockSize <= 256), std::uint8_t,
+			std::conditional_t<(BlockSize <= 65536), std::uint16_t, std::uint32_t>>;
+
+		// Type of the top and numFree members, numFree must be able to hold BlockSize itself.
+		using count_t = std::conditional_t<(BlockSize < 32768), std::int16_t, std::int32_t>;
+
+		static_assert(sizeof(index_t) <= sizeof(T), "The type is too small to hold the free list index for this BlockSize, use a smaller BlockSize!");
+
+		// Occupancy bitmap, bit i is set when slot i is allocated.
+		using Bitmap = std::array<std::uint64_t, intern::wordCount(BlockSize)>;
+
 		union Memory {
 			Memory() : index(0) {};
 			~Memory() {};
 
-			// The index being 8 bits is the reason BlockSize must be 256 or less.
-			// To support blocks larger than 256, index would have to be a larger integer type.
-			// However, using a larger integer type would force the Memory union to use more data by default.
-			// Using uint8_t guarantees we can store any type, even char, using the least amount of memory.
-
-			uint8_t index;
+			index_t index;
 			T object;
 		};
 
@@ -32,45 +47,65 @@ namespace ez::intern {
 		using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
 		static bool contains(const MemoryBlock* block, const T* obj) noexcept {
-			return (reinterpret_cast<std::uintptr_t>(block) < reinterpret_cast<std::uintptr_t>(obj)) &&
-				((reinterpret_cast<std::uintptr_t>(block) + BlockBytes) > reinterpret_cast<std::uintptr_t>(obj));
-		}
-
-		// Marks represent the free locations
-		std::bitset<BlockSize> calculateMarks() const noexcept {
-			std::bitset<BlockSize> marks;
-			int offset = top;
-			for (int count = numFree; count > 0; --count) {
-				marks.set(offset);
-				offset = data[offset].index;
-			}
-			return marks;
+			std::uintptr_t base = reinterpret_cast<std::uintptr_t>(block->basePtr());
+			return (base <= reinterpret_cast<std::uintptr_t>(obj)) &&
+				((base + BlockBytes) > reinterpret_cast<std::uintptr_t>(obj));
 		}
 
 		MemoryBlock() noexcept
-			: top(0)
+			: prev(nullptr)
+			, next(nullptr)
+			, prevOpen(nullptr)
+			, nextOpen(nullptr)
+			, top(0)
 			, numFree(BlockSize)
+			, bin(0)
+			, occupied{}
 		{
-			int index = 1;
+			std::size_t index = 1;
 			for (Memory& mem : data) {
-				mem.index = static_cast<std::uint8_t>(index);
+				mem.index = static_cast<index_t>(index);
+				releaseSlot(mem);
 				++index;
 			}
 		}
+#if defined(EZ_POOL_HARDENED)
+		~MemoryBlock() {
+			// The memory goes back to the block source, which must be able to use all of it
+			asanUnpoison(data.data(), sizeof(data));
+		}
+#endif
 
 		T* alloc() noexcept {
 			assert(numFree != 0);
 			--numFree;
 			Memory& mem = data[top];
-			top = static_cast<std::uint16_t>(mem.index);
+			acquireSlot(mem);
+			intern::setBit(occupied.data(), top);
+			top = static_cast<count_t>(mem.index);
 			return &mem.object;
 		}
+		// Allocate up to n slots into out, returns the number allocated.
+		std::size_t alloc_n(T** out, std::size_t n) noexcept {
+			std::size_t count = std::min(n, static_cast<std::size_t>(numFree));
+			for (std::size_t i = 0; i < count; ++i) {
+				Memory& mem = data[top];
+				acquireSlot(mem);
+				intern::setBit(occupied.data(), top);
+				top = static_cast<count_t>(mem.index);
+				out[i] = &mem.object;
+			}
+			numFree -= static_cast<count_t>(count);
+			return count;
+		}
 		void free(const T* obj) noexcept {
 			assert(isAllocated(obj));
 			++numFree;
 			int offset = static_cast<int>(obj - basePtr());
-			data[offset].index = static_cast<std::uint8_t>(top);
-			top = static_cast<std::int16_t>(offset);
+			intern::clearBit(occupied.data(), offset);
+			data[offset].index = static_cast<index_t>(top);
+			releaseSlot(data[offset]);
+			top = static_cast<count_t>(offset);
 		}
 
 		T* basePtr() noexcept {
@@ -84,33 +119,30 @@ namespace ez::intern {
 			return contains(this, obj);
 		}
 		bool isFree(const T* obj) const noexcept {
-			int compare = obj - basePtr();
-			int offset = top;
-			for (int count = numFree; count > 0; --count) {
-				if (compare == offset) {
-					return true;
-				}
-				offset = data[offset].index;
-			}
-			return false;
+			return !isAllocated(obj);
 		}
 		bool isAllocated(const T* obj) const noexcept {
-			return !isFree(obj);
+			return intern::testBit(occupied.data(), static_cast<std::size_t>(obj - basePtr()));
+		}
+
+		// Index of the first allocated slot at or after index, or BlockSize if there is none.
+		int nextAllocated(int index) const noexcept {
+			return intern::findNextSet(occupied.data(), BlockSize, index);
+		}
+		// Index of the last allocated slot at or before index, or -1 if there is none.
+		int prevAllocated(int index) const noexcept {
+			return intern::findPrevSet(occupied.data(), index);
 		}
 
 		iterator begin() noexcept {
-			iterator tmp(this);
-			tmp.findFirst();
-			return tmp;
+			return iterator(this, nextAllocated(0));
 		}
 		iterator end() noexcept {
 			return iterator(this, BlockSize);
 		}
 		
 		const_iterator begin() const noexcept {
-			const_iterator tmp(this);
-			tmp.findFirst();
-			return tmp;
+			return const_iterator(this, nextAllocated(0));
 		}
 		const_iterator end() const noexcept {
 			return const_iterator(this, BlockSize);
@@ -146,28 +178,53 @@ namespace ez::intern {
 
 		iterator erase(const_iterator pos) noexcept {
 			assert(pos != cend());
-			pos.marks[pos.index] = true;
 			free(&*pos);
-			++pos;
-
-			return iterator(this, pos.index, pos.marks);
+			return iterator(this, nextAllocated(pos.index + 1));
 		}
 		iterator erase(const_iterator first, const_iterator last) noexcept {
 			assert(first != cend());
 			while (first != last) {
-				first.marks[first.index] = true;
-				free(&*first);
+				const T* obj = &*first;
 				++first;
+				free(obj);
+			}
+			return iterator(this, first.index);
+		}
+
+		// Free every allocated slot for which pred(slot) returns true, in one pass over the occupancy words.
+		// Returns the number of slots freed. Each slot is freed as soon as pred accepts it, so the block stays consistent if pred throws.
+		template<typename Pred>
+		std::size_t eraseIf(Pred&& pred) {
+			std::size_t erased = 0;
+			for (std::size_t word = 0; word < occupied.size(); ++word) {
+				std::uint64_t bits = occupied[word];
+				while (bits != 0) {
+					int bit = intern::countTrailingZeros(bits);
+					bits &= bits - 1;
+					std::size_t index = word * 64 + static_cast<std::size_t>(bit);
+					Memory& mem = data[index];
+					if (pred(&mem.object)) {
+						occupied[word] &= ~(std::uint64_t(1) << bit);
+						mem.index = static_cast<index_t>(top);
+						releaseSlot(mem);
+						top = static_cast<count_t>(index);
+						++numFree;
+						++erased;
+					}
+				}
 			}
-			return iterator(this, first.index, first.marks);
+			return erased;
 		}
 
 		void clear() noexcept {
 			numFree = BlockSize;
 			top = 0;
-			int index = 1;
+			occupied.fill(0);
+			asanUnpoison(data.data(), sizeof(data));
+			std::size_t index = 1;
 			for (Memory & mem : data) {
-				mem.index = static_cast<std::uint8_t>(index);
+				mem.index = static_cast<index_t>(index);
+				releaseSlot(mem);
 				++index;
 			}
 		}
@@ -183,8 +240,44 @@ namespace ez::intern {
 			return BlockSize;
 		}
 
-		int16_t top, numFree;
+		// Intrusive list of the blocks owned by a pool, used for iteration
+		MemoryBlock* prev, * next;
+		// Intrusive list of the blocks with open slots, the pool keeps one list per occupancy bin
+		MemoryBlock* prevOpen, * nextOpen;
+
+		count_t top, numFree;
+		// Occupancy bin of the open list the block is in, owned by the pool
+		std::uint8_t bin;
+		Bitmap occupied;
 		std::array<Memory, BlockSize> data;
+
+		// Hardened builds fill a free slot past its free list index with a poison pattern, and hide it from AddressSanitizer.
+		// The pattern is checked when the slot is allocated again, which catches writes through dangling pointers.
+		// Only the first PoisonLimit bytes are poisoned, so the cost stays bounded for large objects.
+		// Both compile away in other builds.
+		static constexpr std::size_t PoisonLimit = 64;
+		static constexpr std::size_t PoisonBytes = std::min(sizeof(Memory), PoisonLimit) > sizeof(index_t) ? std::min(sizeof(Memory), PoisonLimit) - sizeof(index_t) : 0;
+
+		static void releaseSlot(Memory& mem) noexcept {
+#if defined(EZ_POOL_HARDENED)
+			unsigned char* bytes = reinterpret_cast<unsigned char*>(&mem);
+			poisonBytes(bytes + sizeof(index_t), PoisonBytes);
+			asanPoison(&mem, sizeof(Memory));
+#else
+			(void)mem;
+#endif
+		}
+		static void acquireSlot(Memory& mem) noexcept {
+#if defined(EZ_POOL_HARDENED)
+			asanUnpoison(&mem, sizeof(Memory));
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&mem);
+			if (!poisonIntact(bytes + sizeof(index_t), PoisonBytes)) {
+				reportViolation(PoolViolation::UseAfterFree, &mem.object);
+			}
+#else
+			(void)mem;
+#endif
+		}
 	
 		// Impl iterators
 		template<typename Block, typename U>
@@ -199,18 +292,14 @@ namespace ez::intern {
 			iterator_impl()
 				: block(nullptr)
 				, index(0)
+				, bits(0)
 			{}
 			iterator_impl(Block* it, int _index)
 				: block(it)
 				, index(_index)
 			{
-				marks = block->calculateMarks();
+				loadBits();
 			}
-			iterator_impl(Block* it, int _index, std::bitset<BlockSize> _marks)
-				: block(it)
-				, index(_index)
-				, marks(_marks)
-			{}
 			~iterator_impl()
 			{}
 
@@ -253,34 +342,45 @@ namespace ez::intern {
 			}
 
 			void findFirst() {
-				index = 0;
-				while ((index < BlockSize) && marks.test(index)) {
-					++index;
-				}
+				index = block->nextAllocated(0);
+				loadBits();
 			}
 			void findLast() {
-				index = BlockSize - 1;
-				while ((index >= 0) && marks.test(index)) {
-					++index;
-				}
+				index = block->prevAllocated(BlockSize - 1);
+				loadBits();
 			}
 		protected:
 			friend class MemoryBlock;
+			// Occupancy is read from the block itself, so iterators stay small and cheap to copy.
 			Block* block;
 			int index;
-			std::bitset<BlockSize> marks;
+			// Allocated slots after index within the current occupancy word.
+			// Caching them keeps the common step down to a count trailing zeros.
+			std::uint64_t bits;
+
+			void loadBits() {
+				if (index >= 0 && index < static_cast<int>(BlockSize)) {
+					// Shifting 2 instead of 1 masks off the current index as well, and wraps to zero at bit 63.
+					bits = block->occupied[index / 64] & ~((std::uint64_t(2) << (index % 64)) - 1);
+				}
+				else {
+					bits = 0;
+				}
+			}
 
 			void nextIndex() {
-				++index;
-				while ((index < BlockSize) && marks.test(index)) {
-					++index;
+				if (bits != 0) {
+					index = (index & ~63) + intern::countTrailingZeros(bits);
+					bits &= bits - 1;
+				}
+				else {
+					index = block->nextAllocated((index | 63) + 1);
+					loadBits();
 				}
 			}
 			void prevIndex() {
-				--index;
-				while ((index >= 0) && marks.test(index)) {
-					--index;
-				}
+				index = block->prevAllocated(index - 1);
+				loadBits();
 			}
 		}; // End iterator
 	public:
@@ -295,13 +395,13 @@ namespace ez::intern {
 			iterator(MemoryBlock * block, int _index = 0)
 				: base_t(block, _index)
 			{}
-			iterator(MemoryBlock* block, int _index, std::bitset<BlockSize> _marks)
-				: base_t(block, _index, _marks)
-			{}
 
-			MemoryBlock* getBlock() {
+			MemoryBlock* getBlock() const {
 				return base_t::block;
 			}
+			int getIndex() const {
+				return base_t::index;
+			}
 			bool inRange() const {
 				return (base_t::index >= 0) && (base_t::index < BlockSize);
 			}
@@ -327,25 +427,25 @@ namespace ez::intern {
 			const_iterator(const MemoryBlock* block, int _index = 0)
 				: base_t(block, _index)
 			{}
-			const_iterator(const MemoryBlock* block, int _index, std::bitset<BlockSize> _marks)
-				: base_t(block, _index, _marks)
-			{}
 
 			const_iterator(const iterator& other) {
 				base_t::block = other.block;
 				base_t::index = other.index;
-				base_t::marks = other.marks;
+				base_t::bits = other.bits;
 			}
 			const_iterator& operator=(const iterator& other) {
 				base_t::block = other.block;
 				base_t::index = other.index;
-				base_t::marks = other.marks;
+				base_t::bits = other.bits;
 				return *this;
 			}
 
-			const MemoryBlock* getBlock() {
+			const MemoryBlock* getBlock() const {
 				return base_t::block;
 			}
+			int getIndex() const {
+				return base_t::index;
+			}
 			bool inRange() const {
 				return (base_t::index >= 0) && (base_t::index < BlockSize);
 			}
@@ -0,0 +1,1387 @@
+#pragma once
+#include <new>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <cinttypes>
+#include <cassert>
+#include "MemoryBlock.hpp"
+#include "Storage.hpp"
+#include "Bits.hpp"
+#include "Prefetch.hpp"
+#include "VirtualMemory.hpp"
+#include "Hardening.hpp"
+#include "../BlockSource.hpp"
+#include "../PoolStats.hpp"
+
+namespace ez {
+	// What trim() does with the spare empty blocks it removes
+	enum class TrimMode {
+		// Return the block to the block source
+		Release,
+		// Keep the block, but release the pages of its slots with MADV_DONTNEED
+		Decommit,
+		// Keep the block, but release the pages of its slots with MADV_FREE where available
+		DecommitLazy
+	};
+};
+
+namespace ez::intern {
+	// This header is for internal use only
+
+	/*
+	The untyped part of a memory pool: blocks of raw slots, the block map, the open lists and trimming.
+	It only depends on the size and alignment of the slots, so every pool over types of the same size and alignment
+	shares a single instantiation, and the typed pools are thin wrappers that cast slots to objects.
+	See BasicMemoryPool for the behavior.
+	*/
+	template<template<typename K, typename V> typename map_template, std::size_t SlotSize, std::size_t SlotAlign, std::size_t BlockSize, bool Aligned, typename Source, typename Stats>
+	class PoolCore : private Stats {
+	public:
+		using Slot = Storage<SlotSize, SlotAlign>;
+		using Block = MemoryBlock<Slot, BlockSize>;
+		using block_iterator = typename Block::iterator;
+	private:
+		using Alloc = std::array<Block*, 2>;
+
+		using map_t = map_template<std::uintptr_t, Alloc>;
+		using const_map_iterator = typename map_t::const_iterator;
+		
+		// Block size in bytes
+		static constexpr std::ptrdiff_t BlockBytes = sizeof(Block);
+		// Alignment of each block in bytes
+		static constexpr std::size_t BlockAlign = Aligned ? ceilPow2(sizeof(Block)) : alignof(Block);
+		// Size of the address range covered by a single map key
+		static constexpr std::uintptr_t IdBytes = Aligned ? BlockAlign : BlockBytes;
+		// Distance between the blocks carved from one chunk
+		static constexpr std::size_t BlockStride = Aligned ? BlockAlign : sizeof(Block);
+
+		// A single allocation from the source holding several blocks back to back.
+		// It goes back to the source once none of its blocks is in use.
+		struct Chunk {
+			unsigned char* mem;
+			// Number of blocks the chunk has room for
+			std::size_t blocks;
+			// Number of blocks carved out of it and not yet destroyed
+			std::size_t live;
+		};
+
+		// Number of occupancy bins for partially used blocks
+		static constexpr std::size_t OpenBins = 8;
+		// Bin of the blocks that are in no open list: the top block, full blocks and idle blocks
+		static constexpr std::uint8_t NoBin = 0xFF;
+
+		// Blocks with open slots, in intrusive lists by occupancy. Bin 0 holds the empty blocks,
+		// bins 1 to OpenBins the partially used ones, fuller blocks in higher bins.
+		// Allocation takes the fullest block, so sparse blocks drain and become reclaimable.
+		std::array<Block*, OpenBins + 1> openLists;
+		// Bit i is set when openLists[i] is not empty
+		std::uint32_t openMask;
+		// Map of all allocated blocks
+		map_t map;
+		// Intrusive list of all allocated blocks, used for iteration and destruction.
+		// Kept sorted by address, so iteration sweeps memory in one direction.
+		Block* head, * tail;
+		// The block linked most recently, blocks created in a row are usually adjacent in memory.
+		Block* lastLinked;
+
+		// count is the number of allocated objects
+		// bcount is the number of allocated blocks
+		std::ptrdiff_t count, bcount;
+
+		// Block currently allocated from, kept out of the open lists so allocating never touches them.
+		Block* top;
+
+		// Number of empty blocks in the open lists, plus the top block if it is empty
+		std::size_t spare;
+		// Empty blocks with decommitted pages, not in the open lists
+		std::vector<Block*> idle;
+
+		// Automatic trimming, disabled while trimHigh is the maximum
+		std::size_t trimLow, trimHigh;
+		TrimMode trimMode;
+
+		// Chunks holding more than one block, sorted by address
+		std::vector<Chunk> chunks;
+		// Room left in the newest chunk, blocks are carved from it in address order
+		unsigned char* carveNext, * carveEnd;
+		// Blocks destroyed within chunks that are still in use. The first vacantCold have had their pages decommitted,
+		// the rest were destroyed since the last trim, and are decommitted once it ends unless their chunk was released.
+		std::vector<Block*> vacant;
+		std::size_t vacantCold;
+		// Blocks in the next chunk, doubling from growFirst up to growMax. A single block is allocated on its own.
+		std::size_t growFirst, growMax, growNext;
+
+		// Supplies the memory of the blocks
+		Source source;
+	public:
+		class iterator;
+		class const_iterator;
+
+		PoolCore()
+			: openLists{}
+			, openMask(0)
+			, head(nullptr)
+			, tail(nullptr)
+			, lastLinked(nullptr)
+			, count(0)
+			, bcount(0)
+			, top(nullptr)
+			, spare(0)
+			, trimLow(0)
+			, trimHigh(static_cast<std::size_t>(-1))
+			, trimMode(TrimMode::Release)
+			, carveNext(nullptr)
+			, carveEnd(nullptr)
+			, vacantCold(0)
+			, growFirst(1)
+			, growMax(1)
+			, growNext(1)
+		{}
+		explicit PoolCore(Source _source)
+			: openLists{}
+			, openMask(0)
+			, head(nullptr)
+			, tail(nullptr)
+			, lastLinked(nullptr)
+			, count(0)
+			, bcount(0)
+			, top(nullptr)
+			, spare(0)
+			, trimLow(0)
+			, trimHigh(static_cast<std::size_t>(-1))
+			, trimMode(TrimMode::Release)
+			, carveNext(nullptr)
+			, carveEnd(nullptr)
+			, vacantCold(0)
+			, growFirst(1)
+			, growMax(1)
+			, growNext(1)
+			, source(std::move(_source))
+		{}
+		PoolCore(PoolCore && other) noexcept
+			: openLists(other.openLists)
+			, openMask(other.openMask)
+			, map(std::move(other.map))
+			, head(other.head)
+			, tail(other.tail)
+			, lastLinked(other.lastLinked)
+			, count(other.count)
+			, bcount(other.bcount)
+			, top(other.top)
+			, spare(other.spare)
+			, idle(std::move(other.idle))
+			, trimLow(other.trimLow)
+			, trimHigh(other.trimHigh)
+			, trimMode(other.trimMode)
+			, chunks(std::move(other.chunks))
+			, carveNext(other.carveNext)
+			, carveEnd(other.carveEnd)
+			, vacant(std::move(other.vacant))
+			, vacantCold(other.vacantCold)
+			, growFirst(other.growFirst)
+			, growMax(other.growMax)
+			, growNext(other.growNext)
+			, source(std::move(other.source))
+		{
+			stats() = std::move(other.stats());
+			other.openLists.fill(nullptr);
+			other.openMask = 0;
+			other.head = nullptr;
+			other.tail = nullptr;
+			other.lastLinked = nullptr;
+			other.count = 0;
+			other.bcount = 0;
+			other.top = nullptr;
+			other.spare = 0;
+			other.idle.clear();
+			other.chunks.clear();
+			other.carveNext = nullptr;
+			other.carveEnd = nullptr;
+			other.vacant.clear();
+			other.vacantCold = 0;
+		}
+		~PoolCore() {
+			deallocateAll();
+		}
+
+		PoolCore& operator=(PoolCore&& other) noexcept {
+			clear();
+			count = other.count;
+			bcount = other.bcount;
+			openLists = other.openLists;
+			openMask = other.openMask;
+			map = std::move(other.map);
+			head = other.head;
+			tail = other.tail;
+			lastLinked = other.lastLinked;
+			top = other.top;
+			spare = other.spare;
+			idle = std::move(other.idle);
+			trimLow = other.trimLow;
+			trimHigh = other.trimHigh;
+			trimMode = other.trimMode;
+			chunks = std::move(other.chunks);
+			carveNext = other.carveNext;
+			carveEnd = other.carveEnd;
+			vacant = std::move(other.vacant);
+			vacantCold = other.vacantCold;
+			growFirst = other.growFirst;
+			growMax = other.growMax;
+			growNext = other.growNext;
+			source = std::move(other.source);
+			stats() = std::move(other.stats());
+			other.openLists.fill(nullptr);
+			other.openMask = 0;
+			other.head = nullptr;
+			other.tail = nullptr;
+			other.lastLinked = nullptr;
+			other.count = 0;
+			other.bcount = 0;
+			other.top = nullptr;
+			other.spare = 0;
+			other.idle.clear();
+			other.chunks.clear();
+			other.carveNext = nullptr;
+			other.carveEnd = nullptr;
+			other.vacant.clear();
+			other.vacantCold = 0;
+			return *this;
+		}
+		
+		// Returns nullptr if cannot allocate
+		Slot * alloc() {
+			if (top == nullptr) {
+				top = nextTop();
+				if (top == nullptr) {
+					return nullptr;
+				}
+			}
+			if (top->numFree == BlockSize) {
+				--spare;
+			}
+			
+			Slot* obj = top->alloc();
+
+			// Block used up completely, the next block is chosen on the next call to alloc
+			if (top->numFree == 0) {
+				top = nullptr;
+			}
+			
+			++count;
+			stats().onAlloc(1);
+			return obj;
+		}
+
+		void free(Slot* obj) {
+#if defined(EZ_POOL_HARDENED)
+			Block* block = checkedBlock(obj);
+			if (block == nullptr) {
+				return;
+			}
+#else
+			Block* block = resolveBlock(obj);
+
+			// If this triggers, the obj pointer has already been freed.
+			assert(block->isAllocated(obj) && "The object pointer has already been freed!");
+#endif
+			free(block, obj);
+		}
+
+#if defined(EZ_POOL_HARDENED)
+		// Validate a pointer before its object is destroyed, so a bad destroy runs no destructor.
+		// Returns the block to pass to free(block, obj), or nullptr after reporting a violation.
+		Block* check(const Slot* obj) const {
+			return checkedBlock(obj);
+		}
+#endif
+
+		// Free an object whose block was already found
+		void free(Block* block, Slot* obj) {
+			block->free(obj);
+			if (block != top) {
+				rebin(block);
+			}
+			--count;
+			stats().onFree(1);
+			if (block->numFree == BlockSize) {
+				blockEmptied();
+			}
+		}
+
+		// Allocate n objects into out, filling whole blocks at a time.
+		// Returns the number of objects allocated, which is less than n only if a block could not be allocated.
+		std::size_t alloc_n(Slot** out, std::size_t n) {
+			std::size_t done = 0;
+			while (done < n) {
+				if (top == nullptr) {
+					top = nextTop();
+					if (top == nullptr) {
+						break;
+					}
+				}
+				if (top->numFree == BlockSize) {
+					--spare;
+				}
+
+				done += top->alloc_n(out + done, n - done);
+
+				// Block used up completely
+				if (top->numFree == 0) {
+					top = nullptr;
+				}
+			}
+
+			count += static_cast<std::ptrdiff_t>(done);
+			stats().onAlloc(done);
+			return done;
+		}
+
+		// Free n objects, in any order. Consecutive pointers into the same block are released as a group,
+		// and the blocks resolved through the map are cached, so each block is looked up about once however the pointers are shuffled.
+		void free_n(Slot* const* objs, std::size_t n) {
+#if !defined(EZ_POOL_HARDENED)
+			BlockCache cache;
+#endif
+			std::size_t i = 0;
+			while (i < n) {
+#if defined(EZ_POOL_HARDENED)
+				Block* block = checkedBlock(objs[i]);
+				if (block == nullptr) {
+					++i;
+					continue;
+				}
+#else
+				Block* block = cache.resolve(*this, objs[i]);
+#endif
+
+				std::size_t freed = 0;
+				do {
+#if defined(EZ_POOL_HARDENED)
+					if (checkedSlot(block, objs[i])) {
+						block->free(objs[i]);
+						++freed;
+					}
+#else
+					// If this triggers, the obj pointer has already been freed.
+					assert(block->isAllocated(objs[i]) && "The object pointer has already been freed!");
+					block->free(objs[i]);
+					++freed;
+#endif
+					++i;
+				} while (i < n && Block::contains(block, objs[i]));
+
+				if (block != top) {
+					rebin(block);
+				}
+				count -= static_cast<std::ptrdiff_t>(freed);
+				stats().onFree(freed);
+				if (block->numFree == BlockSize) {
+					blockEmptied();
+				}
+			}
+		}
+
+		// eliminate all allocated blocks with no active elements.
+		void shrink() {
+			if (top != nullptr && top->empty()) {
+				rebin(top);
+				top = nullptr;
+			}
+			trim(0, TrimMode::Release);
+			for (Block* block : idle) {
+				destroyBlock(block);
+			}
+			idle.clear();
+			decommitVacant();
+		}
+
+		// Remove spare empty blocks until at most keep of them remain, either releasing them or decommitting their pages.
+		// Decommitting only frees memory for blocks spanning whole pages, the block header always stays resident.
+		// An empty top block is kept.
+		void trim(std::size_t keep, TrimMode mode = TrimMode::Release) {
+			while (spare > keep && openLists[0] != nullptr) {
+				Block* block = openLists[0];
+				unlinkOpen(block);
+				--spare;
+
+				if (mode == TrimMode::Release) {
+					destroyBlock(block);
+				}
+				else {
+					decommitBlock(block, mode == TrimMode::DecommitLazy);
+					idle.push_back(block);
+				}
+			}
+			decommitVacant();
+		}
+
+		// Trim automatically whenever more than high empty blocks are spare, down to low.
+		// The gap between the watermarks keeps a pool that hovers around one size from creating and trimming blocks over and over.
+		void set_trim(std::size_t low, std::size_t high, TrimMode mode = TrimMode::Release) {
+			assert(low <= high);
+			trimLow = low;
+			trimHigh = high;
+			trimMode = mode;
+			if (spare > trimHigh) {
+				trim(trimLow, trimMode);
+			}
+		}
+		// Turn automatic trimming off, the default.
+		void disable_trim() noexcept {
+			trimLow = 0;
+			trimHigh = static_cast<std::size_t>(-1);
+		}
+
+		// Take new blocks from chunks of several blocks each, allocated from the source in one piece.
+		// The first chunk holds first blocks, and every chunk after it twice as many as the last, up to max.
+		// reserve() sizes its chunks for the blocks it needs, up to max.
+		void set_growth(std::size_t first, std::size_t max) noexcept {
+			assert(first >= 1 && first <= max);
+			growFirst = first;
+			growMax = max;
+			growNext = first;
+		}
+
+		// Move objects out of the sparsest blocks into the free slots of the densest ones, then release every empty block.
+		// relocate(from, to) moves the object in one slot to another, then fn(from, to) is called.
+		// Returns the number of objects moved.
+		template<typename Relocate, typename F>
+		std::size_t compact(Relocate&& relocate, F&& fn) {
+			std::vector<Block*> order;
+			order.reserve(static_cast<std::size_t>(bcount));
+			for (Block* block = head; block != nullptr; block = block->next) {
+				if (!block->empty()) {
+					order.push_back(block);
+				}
+			}
+			// Sparsest first
+			std::sort(order.begin(), order.end(), [](const Block* lhs, const Block* rhs) {
+				return lhs->numFree > rhs->numFree;
+			});
+
+			std::size_t moved = 0;
+			std::size_t first = 0, last = order.size();
+			while (last - first > 1) {
+				Block* src = order[first];
+				Block* dst = order[last - 1];
+				if (dst->numFree == 0) {
+					--last;
+					continue;
+				}
+
+				int index = src->nextAllocated(0);
+				Slot* from = src->basePtr() + index;
+				Slot* to = dst->alloc();
+				relocate(from, to);
+				src->free(from);
+				fn(static_cast<const Slot*>(from), to);
+				++moved;
+
+				if (src->empty()) {
+					++first;
+				}
+			}
+
+			// Rebuild the open lists, dropping the emptied blocks
+			openLists.fill(nullptr);
+			openMask = 0;
+			idle.clear();
+			spare = 0;
+			top = nullptr;
+			Block* block = head;
+			while (block != nullptr) {
+				Block* next = block->next;
+				if (block->empty()) {
+					destroyBlock(block);
+				}
+				else {
+					block->bin = NoBin;
+					rebin(block);
+				}
+				block = next;
+			}
+			decommitVacant();
+
+			return moved;
+		}
+		// attempt to reserve storage for 'cap' elements. Automatically rounds up to multiple of BlockSize
+		void reserve(std::size_t cap) {
+			std::size_t mod = cap % BlockSize;
+			if (mod != 0) {
+				cap += BlockSize - mod;
+			}
+			
+			std::ptrdiff_t nblocks = static_cast<std::ptrdiff_t>(cap / BlockSize);
+			while (bcount < nblocks) {
+				Block* block = createBlock(static_cast<std::size_t>(nblocks - bcount));
+				if (block == nullptr) {
+					break;
+				}
+				linkOpen(block, 0);
+				++spare;
+			}
+		}
+
+		// Free all blocks WITHOUT calling destructors for the contained elements.
+		// It is undefined behavior to call this method when elements have been constructed and have non-trivial destructors.
+		void clear() {
+			stats().onFree(static_cast<std::size_t>(count));
+			stats().onBlockDestroy(static_cast<std::size_t>(bcount));
+			openLists.fill(nullptr);
+			openMask = 0;
+			idle.clear();
+			spare = 0;
+			deallocateAll();
+			growNext = growFirst;
+			map.clear();
+			head = nullptr;
+			tail = nullptr;
+			lastLinked = nullptr;
+			count = 0;
+			bcount = 0;
+			top = nullptr;
+		}
+
+		// Total object capacity available
+		ptrdiff_t capacity() const noexcept {
+			return static_cast<std::ptrdiff_t>(bcount * BlockSize);
+		}
+		// Total number of object allocations
+		ptrdiff_t size() const noexcept {
+			return count;
+		}
+
+		bool empty() const noexcept {
+			return size() == 0;
+		}
+
+		iterator begin() noexcept {
+			return iterator(head);
+		}
+		iterator end() noexcept {
+			return iterator();
+		}
+
+		const_iterator begin() const noexcept {
+			return const_iterator(const_cast<PoolCore*>(this)->begin());
+		}
+		const_iterator end() const noexcept {
+			return const_iterator(const_cast<PoolCore*>(this)->end());
+		}
+
+		const_iterator cbegin() const noexcept {
+			return const_iterator(const_cast<PoolCore*>(this)->begin());
+		}
+		const_iterator cend() const noexcept {
+			return const_iterator(const_cast<PoolCore*>(this)->end());
+		}
+
+		// A View of every block holding at least one object, View must be constructible from a Block pointer.
+		template<typename View>
+		std::vector<View> blocks() {
+			std::vector<View> range;
+			range.reserve(static_cast<std::size_t>(bcount));
+			for (Block* block = head; block != nullptr; block = block->next) {
+				if (!block->empty()) {
+					range.push_back(View(block));
+				}
+			}
+			return range;
+		}
+
+		// Call fn(base, slots, mask, full) for every block holding at least one object.
+		// base is the first of the block's BlockSize contiguous slots, mask its occupancy words, full is true when no slot is free.
+		template<typename Fn>
+		void for_each_block(Fn&& fn) {
+			for (Block* block = head; block != nullptr; block = block->next) {
+				if (!block->empty()) {
+					fn(block->basePtr(), static_cast<std::size_t>(BlockSize), static_cast<const std::uint64_t*>(block->occupied.data()), block->numFree == 0);
+				}
+			}
+		}
+		template<typename Fn>
+		void for_each_block(Fn&& fn) const {
+			for (const Block* block = head; block != nullptr; block = block->next) {
+				if (!block->empty()) {
+					fn(block->basePtr(), static_cast<std::size_t>(BlockSize), block->occupied.data(), block->numFree == 0);
+				}
+			}
+		}
+
+		iterator erase(const_iterator _pos) {
+			iterator pos = _pos._inner;
+			assert(pos != end());
+
+			Block* block = pos.blockIter.getBlock();
+			pos.blockIter = block->erase(pos.blockIter);
+			if (block != top) {
+				rebin(block);
+			}
+			--count;
+			stats().onFree(1);
+
+			if (pos.blockIter.atEnd()) {
+				pos.nextBlock(block->next);
+			}
+			// Trimming only removes empty blocks, so pos stays valid
+			if (block->numFree == BlockSize) {
+				blockEmptied();
+			}
+
+			return pos;
+		}
+
+		// Free every object for which pred(slot) returns true, a block at a time.
+		// The open lists, the count and the stats are updated once per block, and trimming is checked once at the end.
+		// Returns the number of objects freed.
+		template<typename Pred>
+		std::size_t erase_if(Pred&& pred) {
+			std::size_t erased = 0, emptied = 0;
+			auto settle = [&](Block* block, std::size_t freed) {
+				if (freed == 0) {
+					return;
+				}
+				if (block != top) {
+					rebin(block);
+				}
+				count -= static_cast<std::ptrdiff_t>(freed);
+				stats().onFree(freed);
+				erased += freed;
+				if (block->empty()) {
+					++emptied;
+				}
+			};
+			// Trimming may destroy any empty block, so it waits until the sweep is done
+			auto finish = [&]() {
+				spare += emptied;
+				if (emptied != 0 && spare > trimHigh) {
+					trim(trimLow, trimMode);
+				}
+			};
+
+			for (Block* block = head; block != nullptr; block = block->next) {
+				if (block->empty()) {
+					continue;
+				}
+				std::size_t before = block->size();
+				try {
+					block->eraseIf(pred);
+				}
+				catch (...) {
+					settle(block, before - block->size());
+					finish();
+					throw;
+				}
+				settle(block, before - block->size());
+			}
+			finish();
+			return erased;
+		}
+
+		void swap(PoolCore& other) noexcept {
+			map.swap(other.map);
+			openLists.swap(other.openLists);
+			std::swap(openMask, other.openMask);
+			std::swap(head, other.head);
+			std::swap(tail, other.tail);
+			std::swap(lastLinked, other.lastLinked);
+			std::swap(count, other.count);
+			std::swap(bcount, other.bcount);
+			std::swap(top, other.top);
+			std::swap(spare, other.spare);
+			idle.swap(other.idle);
+			std::swap(trimLow, other.trimLow);
+			std::swap(trimHigh, other.trimHigh);
+			std::swap(trimMode, other.trimMode);
+			chunks.swap(other.chunks);
+			std::swap(carveNext, other.carveNext);
+			std::swap(carveEnd, other.carveEnd);
+			vacant.swap(other.vacant);
+			std::swap(vacantCold, other.vacantCold);
+			std::swap(growFirst, other.growFirst);
+			std::swap(growMax, other.growMax);
+			std::swap(growNext, other.growNext);
+			std::swap(source, other.source);
+			std::swap(stats(), other.stats());
+		}
+
+		bool contains(const Slot* obj) const {
+			return findBlock(obj) != nullptr;
+		}
+
+		const Stats& get_stats() const noexcept {
+			return *this;
+		}
+
+		// Counters from the stats policy, plus the current layout of the pool.
+		// Walks every block to build the occupancy histogram.
+		PoolSnapshot snapshot() const {
+			PoolSnapshot snap;
+			get_stats().fill(snap);
+
+			snap.size = static_cast<std::size_t>(count);
+			snap.capacity = static_cast<std::size_t>(capacity());
+			snap.blocks = static_cast<std::size_t>(bcount);
+			snap.freeBlocks = (top != nullptr) ? 1 : 0;
+			for (const Block* block : openLists) {
+				for (; block != nullptr; block = block->nextOpen) {
+					++snap.freeBlocks;
+				}
+			}
+			snap.idleBlocks = idle.size();
+			snap.blockBytes = snap.blocks * sizeof(Block);
+			snap.indexBytes = mapBytes(map) + (idle.capacity() + vacant.capacity()) * sizeof(Block*) + chunks.capacity() * sizeof(Chunk);
+
+			for (const Block* block = head; block != nullptr; block = block->next) {
+				std::size_t bin = block->size() * PoolSnapshot::OccupancyBins / BlockSize;
+				snap.occupancy[std::min(bin, PoolSnapshot::OccupancyBins - 1)] += 1;
+			}
+			return snap;
+		}
+
+		Source& get_source() noexcept {
+			return source;
+		}
+		const Source& get_source() const noexcept {
+			return source;
+		}
+
+		iterator find(const Slot* obj) {
+			Block* block = findBlock(obj);
+			if (block == nullptr) {
+				return end();
+			}
+
+			int index = static_cast<int>(obj - block->basePtr());
+			return iterator(block_iterator(block, index));
+		}
+		const_iterator find(const Slot* obj) const {
+			return const_iterator(const_cast<PoolCore*>(this)->find(obj));
+		}
+	private:
+		Stats& stats() noexcept {
+			return *this;
+		}
+
+		// A block just became empty
+		void blockEmptied() {
+			if (++spare > trimHigh) {
+				trim(trimLow, trimMode);
+			}
+		}
+
+		// Open list of a block with the given number of objects
+		static std::uint8_t binOf(std::size_t used) noexcept {
+			if (used == 0) {
+				return 0;
+			}
+			return static_cast<std::uint8_t>(1 + used * OpenBins / BlockSize);
+		}
+
+		void linkOpen(Block* block, std::uint8_t bin) noexcept {
+			Block*& first = openLists[bin];
+			block->bin = bin;
+			block->prevOpen = nullptr;
+			block->nextOpen = first;
+			if (first != nullptr) {
+				first->prevOpen = block;
+			}
+			first = block;
+			openMask |= std::uint32_t(1) << bin;
+		}
+		void unlinkOpen(Block* block) noexcept {
+			std::uint8_t bin = block->bin;
+			if (block->prevOpen != nullptr) {
+				block->prevOpen->nextOpen = block->nextOpen;
+			}
+			else {
+				openLists[bin] = static_cast<Block*>(block->nextOpen);
+				if (openLists[bin] == nullptr) {
+					openMask &= ~(std::uint32_t(1) << bin);
+				}
+			}
+			if (block->nextOpen != nullptr) {
+				block->nextOpen->prevOpen = block->prevOpen;
+			}
+			block->bin = NoBin;
+		}
+
+		// Move a block other than top into the open list matching its occupancy, or out of the lists once full.
+		void rebin(Block* block) noexcept {
+			std::uint8_t bin = block->numFree == 0 ? NoBin : binOf(block->size());
+			if (bin == block->bin) {
+				return;
+			}
+			if (block->bin != NoBin) {
+				unlinkOpen(block);
+			}
+			if (bin != NoBin) {
+				linkOpen(block, bin);
+			}
+		}
+
+		// Choose the next block to allocate from: the fullest open block, then an empty one, then a new one.
+		Block* nextTop() {
+			if (openMask != 0) {
+				Block* block = openLists[63 - countLeadingZeros(openMask)];
+				unlinkOpen(block);
+				return block;
+			}
+			return growBlock();
+		}
+
+		// Get an empty block to allocate from, reusing an idle block before creating a new one.
+		Block* growBlock() {
+			Block* block;
+			if (!idle.empty()) {
+				block = idle.back();
+				idle.pop_back();
+				// The decommitted pages no longer hold the free list
+				block->clear();
+			}
+			else {
+				block = createBlock();
+				if (block == nullptr) {
+					return nullptr;
+				}
+			}
+			++spare;
+			return block;
+		}
+
+		// Release the whole pages within the slots of an empty block
+		static void decommitBlock(Block* block, bool lazy) noexcept {
+			decommitRange(block->basePtr(), Block::BlockBytes, lazy);
+		}
+		// Release the whole pages within a range
+		static void decommitRange(void* ptr, std::size_t bytes, bool lazy) noexcept {
+			std::uintptr_t page = static_cast<std::uintptr_t>(pageSize());
+			std::uintptr_t base = reinterpret_cast<std::uintptr_t>(ptr);
+			std::uintptr_t first = (base + page - 1) & ~(page - 1);
+			std::uintptr_t last = (base + bytes) & ~(page - 1);
+			if (first < last) {
+				decommitPages(reinterpret_cast<void*>(first), last - first, lazy);
+			}
+		}
+
+		// Calculate a block multiple from a pointer
+		static std::uintptr_t blockId(const void* base) noexcept {
+			return reinterpret_cast<std::uintptr_t>(base) / IdBytes;
+		}
+
+		// Only valid for aligned pools, masks the object pointer to find the owning block.
+		static Block* blockOf(const Slot* obj) noexcept {
+			static_assert(Aligned, "Blocks can only be found by masking when the pool is aligned!");
+			return reinterpret_cast<Block*>(reinterpret_cast<std::uintptr_t>(obj) & ~static_cast<std::uintptr_t>(BlockAlign - 1));
+		}
+
+		// Direct mapped cache of the blocks resolved by a call to free_n, indexed by map key.
+		// Aligned pools resolve by masking, so they skip it.
+		struct BlockCache {
+			static constexpr std::size_t Size = 256;
+
+			// Zero is never the key of a block
+			std::array<std::uintptr_t, Aligned ? 1 : Size> ids{};
+			std::array<Block*, Aligned ? 1 : Size> blocks;
+
+			Block* resolve(const PoolCore& pool, const Slot* obj) {
+				if constexpr (Aligned) {
+					return pool.resolveBlock(obj);
+				}
+				else {
+					std::uintptr_t id = blockId(obj);
+					std::size_t index = id % Size;
+					// A key can cover two blocks, so the cached one must still contain the object
+					if (ids[index] == id && Block::contains(blocks[index], obj)) {
+						assert(pool.findBlock(obj) == blocks[index] && "The object pointer is not from this pool!");
+						return blocks[index];
+					}
+					Block* block = pool.resolveBlock(obj);
+					ids[index] = id;
+					blocks[index] = block;
+					return block;
+				}
+			}
+		};
+
+		// Find the block of an object known to be from this pool
+		Block* resolveBlock(const Slot* obj) const {
+			Block* block;
+			if constexpr (Aligned) {
+				block = blockOf(obj);
+
+				// This assertion triggers if the obj is not from this pool
+				assert(findBlock(obj) == block && "The object pointer is not from this pool!");
+			}
+			else {
+				block = findBlock(obj);
+
+				// This assertion triggers if the obj is not from this pool
+				assert(block != nullptr && "The object pointer is not from this pool!");
+			}
+			return block;
+		}
+
+#if defined(EZ_POOL_HARDENED)
+		// Constant time checks of a free: the block is found through the map even in aligned pools,
+		// then the pointer must be on a slot boundary and the slot allocated. Returns nullptr after reporting a violation.
+		Block* checkedBlock(const Slot* obj) const {
+			Block* block = findBlock(obj);
+			if (block == nullptr) {
+				reportViolation(PoolViolation::ForeignPointer, obj);
+				return nullptr;
+			}
+			return checkedSlot(block, obj) ? block : nullptr;
+		}
+		static bool checkedSlot(const Block* block, const Slot* obj) {
+			std::uintptr_t offset = reinterpret_cast<std::uintptr_t>(obj) - reinterpret_cast<std::uintptr_t>(block->basePtr());
+			if (offset % sizeof(Slot) != 0) {
+				reportViolation(PoolViolation::ForeignPointer, obj);
+				return false;
+			}
+			if (!block->isAllocated(obj)) {
+				reportViolation(PoolViolation::DoubleFree, obj);
+				return false;
+			}
+			return true;
+		}
+#endif
+
+		// Find the block containing obj using the map, returns nullptr if obj is not from this pool.
+		Block* findBlock(const Slot* obj) const {
+			const_map_iterator iter = map.find(blockId(obj));
+			if (iter == map.end()) {
+				return nullptr;
+			}
+
+			// Aligned blocks never straddle a key, so only the first entry is used.
+			for (Block* block : iter->second) {
+				if (block != nullptr && Block::contains(block, obj)) {
+					return block;
+				}
+			}
+			return nullptr;
+		}
+
+		// Memory for a new block: a vacant block of a chunk, the rest of the newest chunk, a new chunk, or a block of its own.
+		// want is the number of blocks the caller is about to create, it sizes the new chunk.
+		Block* allocateBlock(std::size_t want) noexcept {
+			void* mem;
+			if (!vacant.empty()) {
+				// Resident blocks come off the back first
+				mem = vacant.back();
+				vacant.pop_back();
+				vacantCold = std::min(vacantCold, vacant.size());
+				++chunkOf(mem)->live;
+			}
+			else if (carveNext != carveEnd) {
+				mem = carve();
+			}
+			else if (std::size_t n = std::max(growNext, std::min(want, growMax)); n > 1 && allocateChunk(n)) {
+				mem = carve();
+			}
+			else {
+				// Also the fallback when a chunk cannot be allocated
+				mem = source.allocate(sizeof(Block), BlockAlign);
+				if (mem == nullptr) {
+					return nullptr;
+				}
+				growNext = std::min(growNext * 2, growMax);
+			}
+			return new (mem) Block{};
+		}
+		void deallocateBlock(Block* block) {
+			block->~Block();
+			Chunk* chunk = chunkOf(block);
+			if (chunk == nullptr) {
+				source.deallocate(block, sizeof(Block), BlockAlign);
+				return;
+			}
+
+			if (--chunk->live == 0) {
+				releaseChunk(chunk);
+			}
+			else {
+				// The chunk stays, so only the pages of the block can be given back, once the caller is done destroying blocks
+				vacant.push_back(block);
+			}
+		}
+
+		// Deallocate every block in the list, without touching the map
+		void deallocateAll() noexcept {
+			Block* block = head;
+			while (block != nullptr) {
+				Block* next = block->next;
+				block->~Block();
+				if (chunks.empty() || chunkOf(block) == nullptr) {
+					source.deallocate(block, sizeof(Block), BlockAlign);
+				}
+				block = next;
+			}
+			for (const Chunk& chunk : chunks) {
+				source.deallocate(chunk.mem, chunk.blocks * BlockStride, BlockAlign);
+			}
+			chunks.clear();
+			vacant.clear();
+			vacantCold = 0;
+			carveNext = nullptr;
+			carveEnd = nullptr;
+		}
+
+		// The chunk holding a block, or nullptr if the block was allocated on its own
+		Chunk* chunkOf(const void* ptr) noexcept {
+			const unsigned char* mem = static_cast<const unsigned char*>(ptr);
+			auto iter = std::upper_bound(chunks.begin(), chunks.end(), mem, [](const unsigned char* lhs, const Chunk& rhs) {
+				return std::less<const unsigned char*>{}(lhs, rhs.mem);
+			});
+			if (iter == chunks.begin()) {
+				return nullptr;
+			}
+			--iter;
+			if (!std::less<const unsigned char*>{}(mem, iter->mem + iter->blocks * BlockStride)) {
+				return nullptr;
+			}
+			return &*iter;
+		}
+
+		// Allocate a chunk of n blocks to carve from, abandoning what was left of the previous one
+		bool allocateChunk(std::size_t n) noexcept {
+			void* mem = source.allocate(n * BlockStride, BlockAlign);
+			if (mem == nullptr) {
+				return false;
+			}
+			Chunk chunk{ static_cast<unsigned char*>(mem), n, 0 };
+			auto iter = std::upper_bound(chunks.begin(), chunks.end(), chunk.mem, [](const unsigned char* lhs, const Chunk& rhs) {
+				return std::less<const unsigned char*>{}(lhs, rhs.mem);
+			});
+			try {
+				chunks.insert(iter, chunk);
+			}
+			catch (...) {
+				source.deallocate(mem, n * BlockStride, BlockAlign);
+				return false;
+			}
+			carveNext = chunk.mem;
+			carveEnd = chunk.mem + n * BlockStride;
+			growNext = std::min(growNext * 2, growMax);
+			return true;
+		}
+		// Decommit the blocks vacated within chunks that are still in use
+		void decommitVacant() noexcept {
+			for (std::size_t i = vacantCold; i < vacant.size(); ++i) {
+				decommitRange(vacant[i], BlockStride, false);
+			}
+			vacantCold = vacant.size();
+		}
+		void* carve() noexcept {
+			void* mem = carveNext;
+			carveNext += BlockStride;
+			++chunkOf(mem)->live;
+			return mem;
+		}
+
+		// Return a chunk none of whose blocks is in use, along with its vacant blocks
+		void releaseChunk(Chunk* chunk) noexcept {
+			unsigned char* first = chunk->mem;
+			unsigned char* last = chunk->mem + chunk->blocks * BlockStride;
+			auto inChunk = [&](Block* block) {
+				unsigned char* mem = reinterpret_cast<unsigned char*>(block);
+				return !std::less<unsigned char*>{}(mem, first) && std::less<unsigned char*>{}(mem, last);
+			};
+			std::size_t kept = 0, cold = 0;
+			for (std::size_t i = 0; i < vacant.size(); ++i) {
+				if (!inChunk(vacant[i])) {
+					cold += i < vacantCold ? 1 : 0;
+					vacant[kept++] = vacant[i];
+				}
+			}
+			vacant.resize(kept);
+			vacantCold = cold;
+			if (carveNext != carveEnd && !std::less<unsigned char*>{}(carveNext, first) && std::less<unsigned char*>{}(carveNext, last)) {
+				carveNext = nullptr;
+				carveEnd = nullptr;
+			}
+			source.deallocate(first, chunk->blocks * BlockStride, BlockAlign);
+			chunks.erase(chunks.begin() + (chunk - chunks.data()));
+		}
+
+		static bool below(const Block* lhs, const Block* rhs) noexcept {
+			return std::less<const Block*>{}(lhs, rhs);
+		}
+
+		// The block that a new block must follow to keep the list sorted, nullptr if it becomes the head.
+		Block* linkPosition(const Block* block) const noexcept {
+			if (tail == nullptr || below(tail, block)) {
+				return tail;
+			}
+			if (below(block, head)) {
+				return nullptr;
+			}
+			if (lastLinked != nullptr && below(lastLinked, block) && below(block, lastLinked->next)) {
+				return lastLinked;
+			}
+
+			// Search in from both ends, the block lies strictly between head and tail
+			Block* low = head;
+			Block* high = tail;
+			while (true) {
+				if (below(block, low->next)) {
+					return low;
+				}
+				low = low->next;
+				if (below(high->prev, block)) {
+					return high->prev;
+				}
+				high = high->prev;
+			}
+		}
+
+		void linkBlock(Block* block) noexcept {
+			Block* after = linkPosition(block);
+			Block* before = after != nullptr ? after->next : head;
+
+			block->prev = after;
+			block->next = before;
+			if (after != nullptr) {
+				after->next = block;
+			}
+			else {
+				head = block;
+			}
+			if (before != nullptr) {
+				before->prev = block;
+			}
+			else {
+				tail = block;
+			}
+			lastLinked = block;
+		}
+		void unlinkBlock(Block* block) noexcept {
+			if (lastLinked == block) {
+				lastLinked = block->prev;
+			}
+			if (block->prev != nullptr) {
+				block->prev->next = block->next;
+			}
+			else {
+				head = block->next;
+			}
+			if (block->next != nullptr) {
+				block->next->prev = block->prev;
+			}
+			else {
+				tail = block->prev;
+			}
+		}
+
+		// Create a new block, insert it into the map, and return the pointer to the new block.
+		// want is the number of blocks about to be created, counting this one.
+		// Returns nullptr if allocation fails.
+		Block * createBlock(std::size_t want = 1) {
+			Block* block = allocateBlock(want);
+			if (!block) {
+				return nullptr;
+			}
+			++bcount;
+			stats().onBlockCreate();
+			linkBlock(block);
+			block->bin = NoBin;
+
+			if constexpr (Aligned) {
+				// The whole block lies within a single key
+				map.insert({ blockId(block), Alloc{ block, nullptr } });
+				return block;
+			}
+
+			std::uintptr_t low = blockId(block->basePtr());
+			std::uintptr_t high = low + 1;
+			
+			auto iter = map.find(low);
+			
+			if (iter == map.end()) {
+				// If low is NOT in map, add to map as the second half of alloc
+				map.insert(iter, { low, Alloc{ nullptr, block } });
+			}
+			else {
+				// If low is in map already, set the second half of alloc to new block 
+				assert(iter->second[1] == nullptr);
+				iter->second[1] = block;
+			}
+
+			iter = map.find(high);
+			if (iter == map.end()) {
+				// If low is NOT in map, add to map as the first half of alloc
+				map.insert(iter, {high, Alloc{ block, nullptr }});
+			}
+			else {
+				// If low is in map already, set the first half of alloc to new block
+				assert(iter->second[0] == nullptr);
+				iter->second[0] = block;
+			}
+
+			return block;
+		}
+		void destroyBlock(Block * block) {
+			unlinkBlock(block);
+
+			if constexpr (Aligned) {
+				map.erase(blockId(block));
+				--bcount;
+				stats().onBlockDestroy(1);
+				deallocateBlock(block);
+				return;
+			}
+
+			std::uintptr_t low = blockId(block->basePtr());
+			std::uintptr_t high = low + 1;
+
+			auto iter = map.find(low);
+			assert(iter != map.end()); // The block must exist
+
+			assert(iter->second[1] == block);
+			iter->second[1] = nullptr;
+			if (iter->second[0] == nullptr) {
+				map.erase(iter);
+			}
+
+			iter = map.find(high);
+			assert(iter != map.end()); // The block must exist
+
+			assert(iter->second[0] == block);
+			iter->second[0] = nullptr;
+			if (iter->second[1] == nullptr) {
+				map.erase(iter);
+			}
+
+			--bcount;
+			stats().onBlockDestroy(1);
+			deallocateBlock(block);
+		}
+
+		
+	public:
+		// Iterators only hold the current block and slot index, blocks are visited through the intrusive block list.
+		class iterator {
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = Slot;
+			using reference = value_type&;
+			using pointer = value_type*;
+			using difference_type = std::ptrdiff_t;
+
+			iterator() noexcept = default;
+			~iterator() = default;
+			iterator(const iterator& other) noexcept = default;
+			iterator& operator=(const iterator & other) noexcept = default;
+
+			// Start at the first allocated object of block, or of the blocks following it.
+			explicit iterator(Block* block) noexcept {
+				nextBlock(block);
+			}
+			explicit iterator(block_iterator bit) noexcept
+				: blockIter(bit)
+			{}
+
+			iterator& operator++() {
+				++blockIter;
+				if (blockIter.atEnd()) {
+					nextBlock(blockIter.getBlock()->next);
+				}
+				return *this;
+			}
+			iterator operator++(int) {
+				iterator copy = *this;
+				++(*this);
+				return copy;
+			}
+
+			bool operator==(const iterator& other) const noexcept {
+				return (blockIter.getBlock() == other.blockIter.getBlock()) && (blockIter == other.blockIter);
+			}
+			bool operator!=(const iterator& other) const noexcept {
+				return !(*this == other);
+			}
+
+			reference operator*() noexcept {
+				return *blockIter;
+			}
+			pointer operator->() noexcept {
+				return &*blockIter;
+			}
+		protected:
+			friend class PoolCore;
+			block_iterator blockIter;
+
+			// Move to the first allocated object of block, skipping empty blocks.
+			// Becomes the end iterator when there are no more objects.
+			void nextBlock(Block* block) noexcept {
+				while (block != nullptr) {
+					int index = block->nextAllocated(0);
+					if (index != BlockSize) {
+						blockIter = block_iterator(block, index);
+						// Start loading the next block while this one is visited
+						if (block->next != nullptr) {
+							prefetch(&block->next->occupied);
+							prefetch(block->next->basePtr());
+						}
+						return;
+					}
+					block = block->next;
+				}
+				blockIter = block_iterator{};
+			}
+		}; // End iterator
+		
+		class const_iterator {
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = const Slot;
+			using reference = value_type&;
+			using pointer = value_type*;
+			using difference_type = std::ptrdiff_t;
+
+			const_iterator() noexcept = default;
+			~const_iterator() = default;
+			const_iterator(const const_iterator&) noexcept = default;
+			const_iterator& operator=(const const_iterator&) noexcept = default;
+
+			const_iterator(const iterator & other) noexcept
+				: _inner(other)
+			{}
+			const_iterator& operator=(const iterator& other) noexcept {
+				_inner = other;
+				return *this;
+			}
+
+			const_iterator& operator++() noexcept {
+				++_inner;
+				return *this;
+			}
+			const_iterator operator++(int) noexcept {
+				const_iterator copy = *this;
+				++(*this);
+				return copy;
+			}
+
+			bool operator==(const const_iterator& other) const noexcept {
+				return _inner == other._inner;
+			}
+			bool operator!=(const const_iterator& other) const noexcept {
+				return _inner != other._inner;
+			}
+
+			reference operator*() noexcept {
+				return *_inner;
+			}
+			pointer operator->() noexcept {
+				return &*_inner;
+			}
+		private:
+			friend class PoolCore;
+			iterator _inner;
+		};
+	};
+};
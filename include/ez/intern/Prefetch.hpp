@@ -0,0 +1,20 @@
+#pragma once
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+namespace ez::intern {
+	// This header is for internal use only
+
+	// Hint that the cache line holding ptr will be read soon.
+	inline void prefetch(const void* ptr) noexcept {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		_mm_prefetch(static_cast<const char*>(ptr), _MM_HINT_T0);
+#elif defined(__GNUC__) || defined(__clang__)
+		__builtin_prefetch(ptr);
+#else
+		(void)ptr;
+#endif
+	}
+};
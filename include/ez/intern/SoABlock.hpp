@@ -0,0 +1,168 @@
+#pragma once
+#include <new>
+#include <tuple>
+#include <memory>
+#include <array>
+#include <algorithm>
+#include <type_traits>
+#include <cinttypes>
+#include <cstring>
+#include <cassert>
+#include "Bits.hpp"
+#include "Storage.hpp"
+
+namespace ez::intern {
+	// This class is for internal use only
+
+	// Field arrays start on a cache line, so vector loads of a whole block never straddle one at the start.
+	constexpr std::size_t ColumnAlign = 64;
+
+	/*
+	Block of a structure of arrays pool: each field has its own array of BlockSize slots.
+	Occupancy is the same bitmap as the MemoryBlock's, bit i is set when slot i holds a live row.
+	A free slot cannot hold a free list index without clobbering some field, so allocation takes the first clear bit instead.
+	That keeps the live rows packed at the front of the block.
+	*/
+	template<std::size_t BlockSize, typename ... Fields>
+	class SoABlock {
+	public:
+		static_assert(BlockSize > 0, "BlockSize must be at least one!");
+		static_assert(sizeof...(Fields) > 0, "A structure of arrays needs at least one field!");
+
+		using Bitmap = std::array<std::uint64_t, intern::wordCount(BlockSize)>;
+
+		template<std::size_t I>
+		using field_t = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+		static constexpr std::size_t NumFields = sizeof...(Fields);
+
+		SoABlock() noexcept
+			: prev(nullptr)
+			, next(nullptr)
+			, numFree(BlockSize)
+			, occupied{}
+		{
+			// Trivially copyable fields are zeroed, so every slot of their arrays holds a valid value
+			zeroTrivial(std::index_sequence_for<Fields...>{});
+		}
+
+		// Index of the allocated slot, the block must have a free slot.
+		int alloc() noexcept {
+			assert(numFree != 0);
+			for (std::size_t word = 0; word < occupied.size(); ++word) {
+				std::uint64_t open = ~occupied[word] & wordMask(word);
+				if (open != 0) {
+					int index = static_cast<int>(word * 64) + intern::countTrailingZeros(open);
+					occupied[word] |= open & (~open + 1);
+					--numFree;
+					return index;
+				}
+			}
+			assert(false && "The block has no free slots!");
+			return -1;
+		}
+		void free(int index) noexcept {
+			assert(isAllocated(index));
+			intern::clearBit(occupied.data(), static_cast<std::size_t>(index));
+			++numFree;
+		}
+
+		bool isAllocated(int index) const noexcept {
+			return intern::testBit(occupied.data(), static_cast<std::size_t>(index));
+		}
+
+		// Index of the first allocated slot at or after index, or BlockSize if there is none.
+		int nextAllocated(int index) const noexcept {
+			return intern::findNextSet(occupied.data(), BlockSize, index);
+		}
+
+		template<std::size_t I>
+		field_t<I>* field() noexcept {
+			return std::launder(reinterpret_cast<field_t<I>*>(std::get<I>(columns).bytes));
+		}
+		template<std::size_t I>
+		const field_t<I>* field() const noexcept {
+			return std::launder(reinterpret_cast<const field_t<I>*>(std::get<I>(columns).bytes));
+		}
+
+		// Default construct every field of a slot
+		void construct(int index) {
+			constructFrom<0>(index, std::tuple<>{});
+		}
+		// Construct every field of a slot from the matching element of args
+		template<typename Tuple>
+		void construct(int index, Tuple&& args) {
+			constructFrom<0>(index, std::forward<Tuple>(args));
+		}
+		void destroy(int index) noexcept {
+			destroyFrom<0>(index);
+		}
+
+		// Destroy the fields of every live slot, and mark all of them free
+		void clear() noexcept {
+			for (int index = nextAllocated(0); index != BlockSize; index = nextAllocated(index + 1)) {
+				destroy(index);
+			}
+			occupied.fill(0);
+			numFree = BlockSize;
+		}
+
+		bool empty() const noexcept {
+			return numFree == BlockSize;
+		}
+		std::size_t size() const noexcept {
+			return BlockSize - numFree;
+		}
+
+		// Intrusive list of the blocks owned by a pool
+		SoABlock* prev, * next;
+		std::size_t numFree;
+		Bitmap occupied;
+	private:
+		template<typename F>
+		using Column = intern::Storage<sizeof(F) * BlockSize, std::max(alignof(F), ColumnAlign)>;
+
+		std::tuple<Column<Fields>...> columns;
+
+		// Bits of the slots that exist in a bitmap word
+		static constexpr std::uint64_t wordMask(std::size_t word) noexcept {
+			std::size_t bits = BlockSize - word * 64;
+			return bits >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << bits) - 1;
+		}
+
+		template<std::size_t ... Is>
+		void zeroTrivial(std::index_sequence<Is...>) noexcept {
+			((std::is_trivially_copyable_v<field_t<Is>> ? (void)std::memset(std::get<Is>(columns).bytes, 0, sizeof(field_t<Is>) * BlockSize) : (void)0), ...);
+		}
+
+		// Construct the fields from I onward, destroying the ones already built if a constructor throws
+		template<std::size_t I, typename Tuple>
+		void constructFrom(int index, Tuple&& args) {
+			if constexpr (I < NumFields) {
+				field_t<I>* ptr = field<I>() + index;
+				if constexpr (std::tuple_size_v<std::remove_reference_t<Tuple>> == 0) {
+					new (ptr) field_t<I>();
+				}
+				else {
+					new (ptr) field_t<I>(std::get<I>(std::forward<Tuple>(args)));
+				}
+				try {
+					constructFrom<I + 1>(index, std::forward<Tuple>(args));
+				}
+				catch (...) {
+					std::destroy_at(ptr);
+					throw;
+				}
+			}
+		}
+		template<std::size_t I>
+		void destroyFrom(int index) noexcept {
+			if constexpr (I < NumFields) {
+				if constexpr (!std::is_trivially_destructible_v<field_t<I>>) {
+					std::destroy_at(field<I>() + index);
+				}
+				destroyFrom<I + 1>(index);
+			}
+		}
+	};
+};
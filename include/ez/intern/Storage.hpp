@@ -0,0 +1,13 @@
+#pragma once
+#include <cstddef>
+
+namespace ez::intern {
+	// This header is for internal use only
+
+	// Raw, suitably aligned memory for any object of at most Size bytes and Align alignment.
+	// Lets a typed pool serve untyped requests.
+	template<std::size_t Size, std::size_t Align>
+	struct alignas(Align) Storage {
+		unsigned char bytes[Size];
+	};
+};
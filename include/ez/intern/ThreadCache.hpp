@@ -0,0 +1,114 @@
+#pragma once
+#include <cinttypes>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+namespace ez::intern {
+	// This header is for internal use only
+
+	// Implemented by the pools that hand out per thread caches.
+	// The registry uses it to return a cache to its pool when the owning thread exits.
+	class CacheOwner {
+	public:
+		virtual void releaseCache(void* cache) noexcept = 0;
+	protected:
+		~CacheOwner() = default;
+	};
+
+	// Process wide table of the live cache owners, keyed by a unique id.
+	// Ids are never reused, so a thread can tell when the pool behind one of its caches has been destroyed.
+	class CacheRegistry {
+	public:
+		static std::uint64_t add(CacheOwner* owner) {
+			std::lock_guard<std::mutex> lock(mutex());
+			std::uint64_t id = ++lastId();
+			owners().insert({ id, owner });
+			return id;
+		}
+		static void remove(std::uint64_t id) {
+			std::lock_guard<std::mutex> lock(mutex());
+			owners().erase(id);
+		}
+
+		static std::mutex& mutex() {
+			static std::mutex value;
+			return value;
+		}
+		// Must be called with the mutex locked
+		static CacheOwner* find(std::uint64_t id) {
+			auto iter = owners().find(id);
+			return iter != owners().end() ? iter->second : nullptr;
+		}
+	private:
+		static std::uint64_t& lastId() {
+			static std::uint64_t value = 0;
+			return value;
+		}
+		static std::unordered_map<std::uint64_t, CacheOwner*>& owners() {
+			static std::unordered_map<std::uint64_t, CacheOwner*> value;
+			return value;
+		}
+	};
+
+	// The caches of the calling thread, one per pool it has used.
+	// The last cache used is checked first, so a thread working with a single pool never searches.
+	class ThreadCaches {
+	public:
+		static ThreadCaches& local() {
+			thread_local ThreadCaches caches;
+			return caches;
+		}
+
+		ThreadCaches()
+			: lastId(0)
+			, last(nullptr)
+		{}
+		~ThreadCaches() {
+			std::lock_guard<std::mutex> lock(CacheRegistry::mutex());
+			for (const Entry& entry : entries) {
+				if (CacheOwner* owner = CacheRegistry::find(entry.id)) {
+					owner->releaseCache(entry.cache);
+				}
+			}
+		}
+
+		void* find(std::uint64_t id) noexcept {
+			if (lastId == id) {
+				return last;
+			}
+			for (const Entry& entry : entries) {
+				if (entry.id == id) {
+					lastId = entry.id;
+					last = entry.cache;
+					return last;
+				}
+			}
+			return nullptr;
+		}
+
+		void insert(std::uint64_t id, void* cache) {
+			{
+				// Drop the entries of pools that no longer exist
+				std::lock_guard<std::mutex> lock(CacheRegistry::mutex());
+				entries.erase(std::remove_if(entries.begin(), entries.end(), [](const Entry& entry) {
+					return CacheRegistry::find(entry.id) == nullptr;
+				}), entries.end());
+			}
+
+			entries.push_back(Entry{ id, cache });
+			lastId = id;
+			last = cache;
+		}
+	private:
+		struct Entry {
+			std::uint64_t id;
+			void* cache;
+		};
+
+		std::uint64_t lastId;
+		void* last;
+		std::vector<Entry> entries;
+	};
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include <new>
+#include <iterator>
+#include <type_traits>
+
+namespace ez::intern {
+	// This class is for internal use only
+
+	// Wraps an iterator over raw slots, presenting the objects of type U that live in them.
+	template<typename Inner, typename U>
+	class TypedIterator {
+	public:
+		using iterator_category = typename std::iterator_traits<Inner>::iterator_category;
+		using value_type = U;
+		using reference = value_type&;
+		using pointer = value_type*;
+		using difference_type = std::ptrdiff_t;
+
+		TypedIterator() noexcept = default;
+		explicit TypedIterator(Inner _inner) noexcept
+			: inner(_inner)
+		{}
+		// Iterators convert to const iterators
+		template<typename OtherInner, typename OtherU, typename = std::enable_if_t<std::is_convertible_v<OtherInner, Inner> && std::is_convertible_v<OtherU*, U*>>>
+		TypedIterator(const TypedIterator<OtherInner, OtherU>& other) noexcept
+			: inner(other.base())
+		{}
+
+		TypedIterator& operator++() {
+			++inner;
+			return *this;
+		}
+		TypedIterator operator++(int) {
+			TypedIterator copy = *this;
+			++inner;
+			return copy;
+		}
+		TypedIterator& operator--() {
+			--inner;
+			return *this;
+		}
+		TypedIterator operator--(int) {
+			TypedIterator copy = *this;
+			--inner;
+			return copy;
+		}
+
+		bool operator==(const TypedIterator& other) const noexcept {
+			return inner == other.inner;
+		}
+		bool operator!=(const TypedIterator& other) const noexcept {
+			return inner != other.inner;
+		}
+
+		reference operator*() const noexcept {
+			return *operator->();
+		}
+		pointer operator->() const noexcept {
+			return std::launder(reinterpret_cast<pointer>(&*inner));
+		}
+
+		const Inner& base() const noexcept {
+			return inner;
+		}
+	private:
+		// The slot iterators only dereference through non-const members
+		mutable Inner inner;
+	};
+};
@@ -0,0 +1,94 @@
+#pragma once
+#include <cinttypes>
+#include <cstddef>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace ez::intern {
+	// This header is for internal use only
+
+	// Size of a transparent huge page on the common platforms
+	constexpr std::size_t HugePageBytes = std::size_t(2) << 20;
+
+	inline std::size_t pageSize() noexcept {
+#if defined(_WIN32)
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return static_cast<std::size_t>(info.dwPageSize);
+#else
+		static const std::size_t value = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+		return value;
+#endif
+	}
+
+	// Map bytes of zeroed, read write memory directly from the operating system. Returns nullptr on failure.
+	// With hugePages the mapping is backed by huge pages when the system has them available,
+	// bytes should then be a multiple of HugePageBytes.
+	inline void* mapPages(std::size_t bytes, bool hugePages) noexcept {
+#if defined(_WIN32)
+		// Large pages need the lock memory privilege, which is rarely granted, so just use normal pages.
+		(void)hugePages;
+		return VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+#if defined(MAP_HUGETLB)
+		if (hugePages) {
+			// Only succeeds when huge pages have been reserved, fall back to transparent huge pages otherwise.
+			void* mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (mem != MAP_FAILED) {
+				return mem;
+			}
+		}
+#endif
+		void* mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mem == MAP_FAILED) {
+			return nullptr;
+		}
+#if defined(MADV_HUGEPAGE)
+		if (hugePages) {
+			madvise(mem, bytes, MADV_HUGEPAGE);
+		}
+#endif
+		return mem;
+#endif
+	}
+
+	// Release the physical pages of a page aligned range, keeping the range itself usable. The contents are lost.
+	// With lazy the pages are only reclaimed under memory pressure (MADV_FREE), which is cheaper when they are reused soon.
+	// Works on any memory the caller owns, not just mappings made by mapPages.
+	inline void decommitPages(void* ptr, std::size_t bytes, bool lazy) noexcept {
+#if defined(_WIN32)
+		(void)lazy;
+		VirtualAlloc(ptr, bytes, MEM_RESET, PAGE_READWRITE);
+#else
+#if defined(MADV_FREE)
+		if (lazy && madvise(ptr, bytes, MADV_FREE) == 0) {
+			return;
+		}
+#else
+		(void)lazy;
+#endif
+		madvise(ptr, bytes, MADV_DONTNEED);
+#endif
+	}
+
+	// Return a mapping made by mapPages, bytes must be the size it was mapped with.
+	inline void unmapPages(void* ptr, std::size_t bytes) noexcept {
+#if defined(_WIN32)
+		(void)bytes;
+		VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+		munmap(ptr, bytes);
+#endif
+	}
+};
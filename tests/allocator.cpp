@@ -0,0 +1,119 @@
+#include <catch2/catch_all.hpp>
+#include <ez/PoolAllocator.hpp>
+#include <ez/PoolResource.hpp>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <string>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+TEST_CASE("pool allocator") {
+	SECTION("list") {
+		std::list<int, ez::PoolAllocator<int>> values;
+		for (int i = 0; i < 1000; ++i) {
+			values.push_back(i);
+		}
+		values.remove_if([](int val) {
+			return val % 2 == 0;
+		});
+		REQUIRE(values.size() == 500);
+		REQUIRE(values.front() == 1);
+
+		auto copy = values;
+		REQUIRE(copy == values);
+		REQUIRE(copy.get_allocator() == values.get_allocator());
+	}
+	SECTION("map") {
+		std::map<int, std::string, std::less<int>, ez::PoolAllocator<std::pair<const int, std::string>>> values;
+		for (int i = 0; i < 1000; ++i) {
+			values.emplace(i, std::to_string(i));
+		}
+		for (int i = 0; i < 1000; i += 3) {
+			values.erase(i);
+		}
+		REQUIRE(values.size() == 666);
+		REQUIRE(values.at(2) == "2");
+	}
+	SECTION("unordered map") {
+		using alloc_t = ez::PoolAllocator<std::pair<const int, int>, 64>;
+		std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, alloc_t> values;
+		for (int i = 0; i < 10000; ++i) {
+			values[i] = i * 2;
+		}
+		REQUIRE(values.size() == 10000);
+		REQUIRE(values[5000] == 10000);
+	}
+	SECTION("rebind") {
+		ez::PoolAllocator<int> a;
+		ez::PoolAllocator<double> b(a);
+		ez::PoolAllocator<int> c;
+		REQUIRE(a == b);
+		REQUIRE(a != c);
+
+		// Copies and rebinds to a type of the same size share a pool
+		ez::PoolAllocator<float> d(a);
+		int* x = a.allocate(1);
+		d.deallocate(reinterpret_cast<float*>(x), 1);
+
+		int* arr = a.allocate(100);
+		a.deallocate(arr, 100);
+	}
+	SECTION("rebind does not throw") {
+		static_assert(std::is_nothrow_constructible_v<ez::PoolAllocator<double>, const ez::PoolAllocator<int>&>);
+
+		// The double pool is created by the first allocation, after both rebinds were made
+		ez::PoolAllocator<int> a;
+		ez::PoolAllocator<double> b(a);
+		ez::PoolAllocator<std::int64_t> c(a);
+		double* x = b.allocate(1);
+		c.deallocate(reinterpret_cast<std::int64_t*>(x), 1);
+
+		std::int64_t* y = c.allocate(1);
+		ez::PoolAllocator<double> d(c);
+		d.deallocate(reinterpret_cast<double*>(y), 1);
+	}
+}
+
+namespace {
+	// Counts the requests reaching the upstream resource
+	class CountingResource : public std::pmr::memory_resource {
+	public:
+		int live = 0;
+	protected:
+		void* do_allocate(std::size_t bytes, std::size_t align) override {
+			++live;
+			return std::pmr::new_delete_resource()->allocate(bytes, align);
+		}
+		void do_deallocate(void* ptr, std::size_t bytes, std::size_t align) override {
+			--live;
+			std::pmr::new_delete_resource()->deallocate(ptr, bytes, align);
+		}
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+			return this == &other;
+		}
+	};
+}
+
+TEST_CASE("pool resource") {
+	CountingResource upstream;
+	{
+		ez::PoolResource<32> resource(&upstream);
+		std::pmr::list<int> values(&resource);
+		for (int i = 0; i < 1000; ++i) {
+			values.push_back(i);
+		}
+		// Every node fits in the pool
+		REQUIRE(upstream.live == 0);
+		REQUIRE(resource.pool().size() == 1000);
+
+		std::pmr::vector<int> large(1000, 0, &resource);
+		REQUIRE(upstream.live == 1);
+
+		values.clear();
+		resource.shrink();
+		REQUIRE(resource.pool().capacity() == 0);
+	}
+	REQUIRE(upstream.live == 0);
+}
@@ -1,6 +1,12 @@
+#include <algorithm>
+#include <array>
 #include <cstdlib>
 #include <memory>
+#include <random>
+#include <set>
+#include <stdexcept>
 #include <string>
+#include <vector>
 #include <fmt/core.h>
 #include <ez/MemoryPool.hpp>
 
@@ -131,3 +137,570 @@ TEST_CASE("Move assign memory pool") {
 	REQUIRE(tracker.expired());
 }
 
+
+TEST_CASE("find in memory pool") {
+	ez::MemoryPool<int> pool;
+
+	std::vector<int*> ptrs;
+	for (int i = 0; i < 600; ++i) {
+		ptrs.push_back(pool.create(i));
+	}
+
+	for (int* ptr : ptrs) {
+		auto iter = pool.find(ptr);
+		REQUIRE(iter != pool.end());
+		REQUIRE(&(*iter) == ptr);
+	}
+
+	int outside = 0;
+	REQUIRE(!pool.contains(&outside));
+	REQUIRE(pool.find(&outside) == pool.end());
+}
+
+TEST_CASE("aligned memory pool") {
+	ez::AlignedMemoryPool<int> pool, other;
+
+	std::vector<int*> ptrs;
+	for (int i = 0; i < 1000; ++i) {
+		ptrs.push_back(pool.create(i));
+	}
+	int* foreign = other.create(-1);
+
+	REQUIRE(pool.size() == 1000);
+	REQUIRE(pool.capacity() == 1024);
+
+	for (int* ptr : ptrs) {
+		REQUIRE(pool.contains(ptr));
+		REQUIRE(!other.contains(ptr));
+
+		auto iter = pool.find(ptr);
+		REQUIRE(iter != pool.end());
+		REQUIRE(&(*iter) == ptr);
+	}
+	REQUIRE(!pool.contains(foreign));
+	REQUIRE(pool.find(foreign) == pool.end());
+
+	// Free every other object, then check the remaining sum
+	long long expected = 0;
+	for (std::size_t i = 0; i < ptrs.size(); ++i) {
+		if (i % 2 == 0) {
+			pool.free(ptrs[i]);
+		}
+		else {
+			expected += *ptrs[i];
+		}
+	}
+	REQUIRE(pool.size() == 500);
+
+	long long sum = 0;
+	for (int val : pool) {
+		sum += val;
+	}
+	REQUIRE(sum == expected);
+
+	for (std::size_t i = 1; i < ptrs.size(); i += 2) {
+		pool.free(ptrs[i]);
+	}
+	REQUIRE(pool.empty());
+
+	pool.shrink();
+	REQUIRE(pool.capacity() == 0);
+}
+
+TEST_CASE("large block memory pool") {
+	ez::MemoryPool<int, 4096> pool;
+
+	std::vector<int*> ptrs;
+	for (int i = 0; i < 10000; ++i) {
+		ptrs.push_back(pool.create(i));
+	}
+	REQUIRE(pool.capacity() == 3 * 4096);
+
+	for (int* ptr : ptrs) {
+		REQUIRE(pool.contains(ptr));
+	}
+	for (std::size_t i = 0; i < ptrs.size(); i += 3) {
+		pool.free(ptrs[i]);
+	}
+
+	std::ptrdiff_t count = 0;
+	for (int val : pool) {
+		REQUIRE(val % 3 != 0);
+		++count;
+	}
+	REQUIRE(count == pool.size());
+}
+
+TEST_CASE("memory pool iterators") {
+	using pool_t = ez::MemoryPool<int, 64>;
+	static_assert(sizeof(pool_t::iterator) <= 3 * sizeof(void*));
+
+	pool_t pool;
+	std::vector<int*> ptrs;
+	for (int i = 0; i < 640; ++i) {
+		ptrs.push_back(pool.create(i));
+	}
+
+	// Empty out an entire block in the middle, and thin out the rest
+	for (int i = 128; i < 192; ++i) {
+		pool.free(ptrs[i]);
+	}
+	{
+		auto iter = pool.begin();
+		while (iter != pool.end()) {
+			if (*iter % 5 != 0) {
+				iter = pool.erase(iter);
+			}
+			else {
+				++iter;
+			}
+		}
+	}
+
+	// Blocks are visited in address order, which need not match the order they were created in
+	std::vector<int> values(pool.begin(), pool.end());
+	std::sort(values.begin(), values.end());
+
+	int expected = 0;
+	for (int val : values) {
+		REQUIRE(val == expected);
+		expected += 5;
+		if (expected == 130) {
+			expected = 195;
+		}
+	}
+	REQUIRE(expected == 640);
+	REQUIRE(pool.size() == 128 - 13);
+}
+
+TEST_CASE("bulk memory pool operations") {
+	ez::MemoryPool<int, 64> pool;
+
+	std::vector<int*> ptrs(1000);
+	REQUIRE(pool.alloc_n(ptrs.data(), 100) == 100);
+	REQUIRE(pool.size() == 100);
+	REQUIRE(pool.capacity() == 128);
+
+	REQUIRE(pool.create_n(ptrs.data() + 100, 900, 7) == 900);
+	REQUIRE(pool.size() == 1000);
+	REQUIRE(pool.capacity() == 1024);
+	for (int i = 100; i < 1000; ++i) {
+		REQUIRE(*ptrs[i] == 7);
+	}
+	for (int* ptr : ptrs) {
+		REQUIRE(pool.contains(ptr));
+	}
+
+	// Free a range crossing several blocks, then a scattered selection
+	pool.free_n(ptrs.data() + 50, 200);
+	REQUIRE(pool.size() == 800);
+
+	std::vector<int*> scattered;
+	for (int i = 250; i < 1000; i += 3) {
+		scattered.push_back(ptrs[i]);
+	}
+	pool.destroy_n(scattered.data(), scattered.size());
+	REQUIRE(pool.size() == static_cast<std::ptrdiff_t>(800 - scattered.size()));
+
+	// Freed slots are reused before new blocks are made
+	std::ptrdiff_t capacity = pool.capacity();
+	std::vector<int*> again(200 + scattered.size());
+	REQUIRE(pool.alloc_n(again.data(), again.size()) == again.size());
+	REQUIRE(pool.capacity() == capacity);
+	REQUIRE(pool.size() == 1000);
+
+	std::size_t count = 0;
+	for (int& val : pool) {
+		(void)val;
+		++count;
+	}
+	REQUIRE(count == 1000);
+}
+
+TEST_CASE("bulk free in any order") {
+	ez::MemoryPool<int, 64> pool;
+	std::vector<int*> ptrs(64 * 8);
+	REQUIRE(pool.create_n(ptrs.data(), ptrs.size(), 1) == ptrs.size());
+
+	// Free every block but the first, the pointers shuffled across blocks
+	std::vector<int*> release(ptrs.begin() + 64, ptrs.end());
+	std::shuffle(release.begin(), release.end(), std::mt19937{ 7 });
+	pool.free_n(release.data(), release.size());
+	REQUIRE(pool.size() == 64);
+	std::set<int*> live(ptrs.begin(), ptrs.begin() + 64);
+	for (int& val : pool) {
+		REQUIRE(live.count(&val) == 1);
+	}
+
+	// Every block emptied is released as a whole
+	pool.shrink();
+	REQUIRE(pool.capacity() == 64);
+	REQUIRE(pool.snapshot().blocks == 1);
+}
+
+TEST_CASE("bulk aligned memory pool operations") {
+	ez::AlignedMemoryPool<int, 64> pool;
+
+	std::vector<int*> ptrs(500);
+	REQUIRE(pool.create_n(ptrs.data(), ptrs.size(), 3) == 500);
+	pool.destroy_n(ptrs.data(), ptrs.size());
+	REQUIRE(pool.empty());
+
+	pool.shrink();
+	REQUIRE(pool.capacity() == 0);
+}
+
+TEST_CASE("compact") {
+	ez::MemoryPool<int, 64> pool;
+
+	std::vector<int*> ptrs;
+	for (int i = 0; i < 64 * 8; ++i) {
+		ptrs.push_back(pool.alloc());
+		*ptrs.back() = i;
+	}
+	for (int i = 0; i < 64 * 8; ++i) {
+		if (i % 4 != 0) {
+			pool.free(ptrs[i]);
+		}
+	}
+
+	std::vector<std::pair<const int*, int*>> moves;
+	pool.compact([&](const int* from, int* to) {
+		moves.push_back({ from, to });
+	});
+	REQUIRE(pool.size() == 128);
+	REQUIRE(pool.capacity() == 128);
+	for (auto& move : moves) {
+		REQUIRE(pool.contains(move.second));
+	}
+
+	long long sum = 0;
+	for (int val : pool) {
+		REQUIRE(val % 4 == 0);
+		sum += val;
+	}
+	REQUIRE(sum == 4ll * (128 * 127 / 2));
+
+	// Nothing left to move
+	REQUIRE(pool.compact() == 0);
+}
+
+TEST_CASE("stats") {
+	using stats_pool_t = ez::BasicMemoryPool<std::unordered_map, int, 64, false, ez::NewBlockSource, ez::PoolStats>;
+	stats_pool_t pool;
+
+	std::vector<int*> ptrs;
+	for (int i = 0; i < 640; ++i) {
+		ptrs.push_back(pool.alloc());
+	}
+	for (int i = 0; i < 320; ++i) {
+		pool.free(ptrs[i]);
+	}
+	pool.free_n(ptrs.data() + 320, 32);
+	pool.shrink();
+
+	ez::PoolSnapshot snap = pool.snapshot();
+	REQUIRE(snap.allocs == 640);
+	REQUIRE(snap.frees == 352);
+	REQUIRE(snap.peakSize == 640);
+	REQUIRE(snap.blocksCreated == 10);
+	REQUIRE(snap.blocksDestroyed == 5);
+	REQUIRE(snap.peakBlocks == 10);
+
+	REQUIRE(snap.size == 288);
+	REQUIRE(snap.capacity == 320);
+	REQUIRE(snap.blocks == 5);
+	REQUIRE(snap.freeBlocks == 1);
+	REQUIRE(snap.indexBytes > 0);
+	REQUIRE(snap.occupancy[ez::PoolSnapshot::OccupancyBins - 1] == 4);
+	REQUIRE(snap.occupancy[5] == 1);
+
+	stats_pool_t moved = std::move(pool);
+	REQUIRE(moved.snapshot().allocs == 640);
+	REQUIRE(pool.snapshot().allocs == 0);
+
+	// Without a stats policy only the layout is reported
+	ez::MemoryPool<int, 64> plain;
+	plain.alloc();
+	snap = plain.snapshot();
+	REQUIRE(snap.allocs == 0);
+	REQUIRE(snap.size == 1);
+	REQUIRE(snap.occupancy[0] == 1);
+}
+
+TEST_CASE("address ordered blocks") {
+	ez::MemoryPool<int, 16> pool;
+
+	std::vector<int*> ptrs;
+	for (int i = 0; i < 16 * 64; ++i) {
+		ptrs.push_back(pool.create(i));
+	}
+	// Release every other block, then grow again so new blocks land in between
+	for (int i = 0; i < 16 * 64; ++i) {
+		if ((i / 16) % 2 == 0) {
+			pool.free(ptrs[i]);
+		}
+	}
+	pool.shrink();
+	std::vector<std::unique_ptr<char[]>> noise;
+	for (int i = 0; i < 16 * 32; ++i) {
+		if (i % 16 == 0) {
+			noise.emplace_back(new char[100]);
+		}
+		pool.create(i);
+	}
+
+	const int* last = nullptr;
+	std::size_t count = 0;
+	for (const int& val : pool) {
+		REQUIRE(std::less<const int*>{}(last, &val));
+		last = &val;
+		++count;
+	}
+	REQUIRE(count == 16 * 64);
+}
+
+TEST_CASE("trimming") {
+	// Blocks of 16KB, so decommitting releases whole pages
+	using item_t = std::array<std::uint64_t, 8>;
+	ez::MemoryPool<item_t, 256> pool;
+
+	std::vector<item_t*> ptrs;
+	for (int i = 0; i < 256 * 10; ++i) {
+		ptrs.push_back(pool.alloc());
+	}
+
+	SECTION("manual") {
+		for (item_t* ptr : ptrs) {
+			pool.free(ptr);
+		}
+		REQUIRE(pool.capacity() == 256 * 10);
+		pool.trim(3);
+		REQUIRE(pool.capacity() == 256 * 3);
+		pool.shrink();
+		REQUIRE(pool.capacity() == 0);
+	}
+	SECTION("watermarks") {
+		pool.set_trim(2, 4);
+		// Free block by block, trimming happens when the fifth block empties
+		for (int i = 0; i < 256 * 4; ++i) {
+			pool.free(ptrs[i]);
+		}
+		REQUIRE(pool.capacity() == 256 * 10);
+		for (int i = 256 * 4; i < 256 * 5; ++i) {
+			pool.free(ptrs[i]);
+		}
+		REQUIRE(pool.capacity() == 256 * 7);
+
+		// Refilling reuses the two spare blocks without growing
+		for (int i = 0; i < 256 * 2; ++i) {
+			pool.alloc();
+		}
+		REQUIRE(pool.capacity() == 256 * 7);
+	}
+	SECTION("decommit") {
+		pool.set_trim(0, 0, ez::TrimMode::Decommit);
+		for (item_t* ptr : ptrs) {
+			pool.free(ptr);
+		}
+		// Decommitted blocks keep their address range
+		REQUIRE(pool.capacity() == 256 * 10);
+		REQUIRE(pool.snapshot().idleBlocks == 10);
+		REQUIRE(pool.empty());
+
+		ptrs.clear();
+		for (int i = 0; i < 256 * 10; ++i) {
+			ptrs.push_back(pool.alloc());
+			(*ptrs.back())[0] = static_cast<std::uint64_t>(i);
+		}
+		REQUIRE(pool.capacity() == 256 * 10);
+		REQUIRE(pool.snapshot().idleBlocks == 0);
+		for (int i = 0; i < 256 * 10; ++i) {
+			REQUIRE((*ptrs[i])[0] == static_cast<std::uint64_t>(i));
+		}
+
+		pool.disable_trim();
+		for (item_t* ptr : ptrs) {
+			pool.free(ptr);
+		}
+		pool.trim(0, ez::TrimMode::DecommitLazy);
+		REQUIRE(pool.snapshot().idleBlocks == 10);
+		pool.shrink();
+		REQUIRE(pool.capacity() == 0);
+	}
+}
+
+TEST_CASE("occupancy binned block selection") {
+	ez::MemoryPool<std::uint64_t, 64> pool;
+
+	std::vector<std::uint64_t*> ptrs;
+	for (int i = 0; i < 64 * 8; ++i) {
+		ptrs.push_back(pool.alloc());
+	}
+
+	// Leave one object in each of the first four blocks, and half of each of the last four
+	std::set<std::uint64_t*> dense;
+	for (int i = 0; i < 64 * 8; ++i) {
+		bool sparse = i < 64 * 4;
+		if (sparse ? (i % 64 != 0) : (i % 2 == 0)) {
+			pool.free(ptrs[i]);
+			if (!sparse) {
+				dense.insert(ptrs[i]);
+			}
+		}
+	}
+
+	// New objects fill the fuller blocks first
+	for (int i = 0; i < 32 * 4; ++i) {
+		std::uint64_t* ptr = pool.alloc();
+		REQUIRE(dense.count(ptr) == 1);
+		dense.erase(ptr);
+	}
+	REQUIRE(pool.capacity() == 64 * 8);
+
+	// So the sparse blocks drain, and can be released
+	for (int i = 0; i < 64 * 4; i += 64) {
+		pool.free(ptrs[i]);
+	}
+	pool.trim(0);
+	REQUIRE(pool.capacity() == 64 * 4);
+	REQUIRE(pool.size() == 64 * 4);
+}
+
+TEST_CASE("erase_if") {
+	ez::MemoryPool<int, 64> pool;
+	std::vector<int*> ptrs;
+	for (int i = 0; i < 64 * 10; ++i) {
+		ptrs.push_back(pool.create(i));
+	}
+
+	SECTION("predicate") {
+		std::size_t erased = ez::erase_if(pool, [](int val) {
+			return val % 3 == 0;
+		});
+		REQUIRE(erased == 214);
+		REQUIRE(pool.size() == 64 * 10 - 214);
+		for (int val : pool) {
+			REQUIRE(val % 3 != 0);
+		}
+
+		// The freed slots are reused before any new block
+		for (int i = 0; i < 214; ++i) {
+			pool.create(-1);
+		}
+		REQUIRE(pool.size() == 64 * 10);
+		REQUIRE(pool.capacity() == 64 * 10);
+	}
+	SECTION("whole blocks") {
+		// Empty the first four blocks, and half of each of the others
+		pool.set_trim(1, 2);
+		std::size_t erased = pool.erase_if([](int val) {
+			return val < 64 * 4 || val % 2 == 0;
+		});
+		REQUIRE(erased == 64 * 4 + 32 * 6);
+		REQUIRE(pool.size() == 32 * 6);
+		// Trimming ran once at the end of the sweep
+		REQUIRE(pool.capacity() == 64 * 7);
+
+		long long sum = 0;
+		for (int val : pool) {
+			sum += val;
+		}
+		long long expected = 0;
+		for (int i = 64 * 4 + 1; i < 64 * 10; i += 2) {
+			expected += i;
+		}
+		REQUIRE(sum == expected);
+
+		REQUIRE(pool.erase_if([](int) { return true; }) == 32 * 6);
+		REQUIRE(pool.empty());
+		REQUIRE(pool.begin() == pool.end());
+	}
+	SECTION("throwing predicate") {
+		int seen = 0;
+		REQUIRE_THROWS(pool.erase_if([&](int val) {
+			if (++seen == 100) {
+				throw std::runtime_error("stop");
+			}
+			return val % 2 == 0;
+		}));
+		// The objects freed before the throw stay freed, and the count matches
+		REQUIRE(pool.size() == 64 * 10 - 50);
+		std::ptrdiff_t live = 0;
+		for (int val : pool) {
+			(void)val;
+			++live;
+		}
+		REQUIRE(live == pool.size());
+	}
+}
+
+TEST_CASE("for_each_block") {
+	ez::MemoryPool<int, 100> pool;
+	std::vector<int*> ptrs;
+	for (int i = 0; i < 100 * 4; ++i) {
+		ptrs.push_back(pool.create(i));
+	}
+	// Leave the second block empty, and the third with every other slot free
+	for (int i = 100; i < 200; ++i) {
+		pool.free(ptrs[i]);
+	}
+	for (int i = 200; i < 300; i += 2) {
+		pool.free(ptrs[i]);
+	}
+	REQUIRE(pool.mask_words == 2);
+
+	std::size_t blocks = 0, full = 0;
+	long long sum = 0, fullSum = 0;
+	std::ptrdiff_t live = 0;
+	pool.for_each_block([&](int* base, std::size_t slots, const std::uint64_t* mask, bool isFull) {
+		REQUIRE(slots == 100);
+		++blocks;
+		if (isFull) {
+			++full;
+			for (std::size_t i = 0; i < slots; ++i) {
+				fullSum += base[i];
+			}
+		}
+		for (std::size_t i = 0; i < slots; ++i) {
+			if (mask[i / 64] & (std::uint64_t(1) << (i % 64))) {
+				REQUIRE(pool.contains(base + i));
+				sum += base[i];
+				++live;
+			}
+			else {
+				REQUIRE(!isFull);
+			}
+		}
+	});
+	REQUIRE(blocks == 3);
+	REQUIRE(full == 2);
+	REQUIRE(live == pool.size());
+
+	long long expected = 0;
+	for (int val : pool) {
+		expected += val;
+	}
+	REQUIRE(sum == expected);
+	// The full blocks hold 0 to 99 and 300 to 399
+	REQUIRE(fullSum == 4950 + 34950);
+
+	// Kernels can write through the base pointer
+	pool.for_each_block([](int* base, std::size_t slots, const std::uint64_t* mask, bool isFull) {
+		for (std::size_t i = 0; i < slots; ++i) {
+			if (isFull || (mask[i / 64] & (std::uint64_t(1) << (i % 64)))) {
+				base[i] = 1;
+			}
+		}
+	});
+	const auto& cpool = pool;
+	std::ptrdiff_t ones = 0;
+	cpool.for_each_block([&](const int* base, std::size_t slots, const std::uint64_t* mask, bool) {
+		for (std::size_t i = 0; i < slots; ++i) {
+			if (mask[i / 64] & (std::uint64_t(1) << (i % 64))) {
+				ones += base[i];
+			}
+		}
+	});
+	REQUIRE(ones == pool.size());
+}
@@ -2,6 +2,8 @@
 #include <fmt/printf.h>
 #include <cstdlib>
 #include <ctime>
+#include <memory>
+#include <vector>
 #include <ez/intern/MemoryBlock.hpp>
 
 using Block = ez::intern::MemoryBlock<int, 256>;
@@ -88,4 +90,81 @@ TEST_CASE("blocks") {
 		}
 	}
 	REQUIRE(count == 0);
-}
\ No newline at end of file
+}
+TEST_CASE("large blocks") {
+	// Small blocks keep the single byte index
+	static_assert(sizeof(ez::intern::MemoryBlock<char, 256>::Memory) == 1);
+	static_assert(sizeof(ez::intern::MemoryBlock<std::uint16_t, 4096>::Memory) == 2);
+	static_assert(sizeof(ez::intern::MemoryBlock<std::uint32_t, 100000>::Memory) == 4);
+
+	using LargeBlock = ez::intern::MemoryBlock<int, 4096>;
+	std::unique_ptr<LargeBlock> block{ new LargeBlock{} };
+
+	for (int i = 0; i < 4096; ++i) {
+		int* ptr = block->alloc();
+		*ptr = i;
+	}
+	REQUIRE(block->size() == 4096);
+
+	// Free everything past the 8 bit range
+	for (int& val : *block) {
+		if (val >= 300) {
+			block->free(&val);
+		}
+	}
+	REQUIRE(block->size() == 300);
+
+	int expected = 0;
+	for (int val : *block) {
+		REQUIRE(val == expected);
+		++expected;
+	}
+	REQUIRE(expected == 300);
+
+	for (int i = 300; i < 4096; ++i) {
+		int* ptr = block->alloc();
+		REQUIRE(block->contains(ptr));
+		*ptr = i;
+	}
+	REQUIRE(block->size() == 4096);
+}
+
+TEST_CASE("block occupancy") {
+	Block pool;
+
+	std::vector<int*> ptrs;
+	for (int i = 0; i < 200; ++i) {
+		ptrs.push_back(pool.alloc());
+		*ptrs.back() = i;
+	}
+
+	for (int i = 0; i < 200; i += 3) {
+		pool.free(ptrs[i]);
+	}
+
+	for (int i = 0; i < 200; ++i) {
+		REQUIRE(pool.isFree(ptrs[i]) == (i % 3 == 0));
+		REQUIRE(pool.isAllocated(ptrs[i]) == (i % 3 != 0));
+	}
+
+	// Forward iteration crosses word boundaries
+	int expected = 1;
+	for (int val : pool) {
+		REQUIRE(val == expected);
+		++expected;
+		if (expected % 3 == 0) {
+			++expected;
+		}
+	}
+
+	// Reverse iteration visits the same slots backwards
+	auto riter = pool.rbegin();
+	REQUIRE(*riter == 199);
+	++riter;
+	REQUIRE(*riter == 197);
+
+	// Freed slots are reused, and marked allocated again
+	int* reused = pool.alloc();
+	REQUIRE(reused == ptrs[198]);
+	REQUIRE(pool.isAllocated(reused));
+}
@@ -0,0 +1,270 @@
+#include <catch2/catch_all.hpp>
+#include <ez/ObjectPool.hpp>
+#include <ez/BlockSource.hpp>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+	// Forwards to operator new, counting the blocks currently allocated
+	struct CountingSource {
+		int* live;
+
+		explicit CountingSource(int* _live = nullptr)
+			: live(_live)
+		{}
+
+		void* allocate(std::size_t bytes, std::size_t align) noexcept {
+			++*live;
+			return ez::NewBlockSource{}.allocate(bytes, align);
+		}
+		void deallocate(void* ptr, std::size_t bytes, std::size_t align) noexcept {
+			--*live;
+			ez::NewBlockSource{}.deallocate(ptr, bytes, align);
+		}
+	};
+}
+
+TEST_CASE("custom block source") {
+	int live = 0;
+	{
+		ez::BasicMemoryPool<std::unordered_map, int, 64, false, CountingSource> pool(CountingSource{ &live });
+		std::vector<int*> ptrs;
+		for (int i = 0; i < 640; ++i) {
+			ptrs.push_back(pool.create(i));
+		}
+		REQUIRE(live == 10);
+
+		for (int i = 0; i < 320; ++i) {
+			pool.free(ptrs[i]);
+		}
+		pool.shrink();
+		REQUIRE(live == 5);
+		REQUIRE(pool.get_source().live == &live);
+	}
+	REQUIRE(live == 0);
+}
+
+TEST_CASE("chunked growth") {
+	using pool_t = ez::BasicMemoryPool<std::unordered_map, int, 64, false, CountingSource>;
+	int live = 0;
+
+	SECTION("geometric") {
+		pool_t pool(CountingSource{ &live });
+		pool.set_growth(1, 8);
+		for (int i = 0; i < 64 * 15; ++i) {
+			REQUIRE(pool.create(i) != nullptr);
+		}
+		// Chunks of 1, 2, 4 and 8 blocks
+		REQUIRE(live == 4);
+		REQUIRE(pool.capacity() == 64 * 15);
+
+		// Past the cap every chunk holds 8 blocks
+		pool.create(0);
+		REQUIRE(live == 5);
+		REQUIRE(pool.capacity() == 64 * 16);
+
+		long long sum = 0;
+		for (int val : pool) {
+			sum += val;
+		}
+		REQUIRE(sum == 64ll * 15 * (64 * 15 - 1) / 2);
+	}
+	SECTION("reserve") {
+		pool_t pool(CountingSource{ &live });
+		pool.set_growth(1, 1024);
+		pool.reserve(64 * 1000);
+		REQUIRE(live == 1);
+		REQUIRE(pool.capacity() == 64 * 1000);
+
+		pool.set_growth(1, 100);
+		pool.reserve(64 * 1250);
+		REQUIRE(live == 4);
+		REQUIRE(pool.capacity() == 64 * 1250);
+
+		pool.shrink();
+		REQUIRE(live == 0);
+		REQUIRE(pool.capacity() == 0);
+	}
+	SECTION("partial release") {
+		pool_t pool(CountingSource{ &live });
+		pool.set_growth(4, 4);
+		std::vector<int*> ptrs;
+		for (int i = 0; i < 64 * 8; ++i) {
+			ptrs.push_back(pool.create(i));
+		}
+		REQUIRE(live == 2);
+
+		// Empty the first two blocks of the first chunk, the chunk itself stays
+		for (int i = 0; i < 128; ++i) {
+			pool.free(ptrs[i]);
+		}
+		pool.shrink();
+		REQUIRE(live == 2);
+		REQUIRE(pool.capacity() == 64 * 6);
+		REQUIRE(!pool.contains(ptrs[0]));
+
+		// The vacant blocks are reused before a new chunk is allocated
+		for (int i = 0; i < 128; ++i) {
+			ptrs[i] = pool.create(i);
+		}
+		REQUIRE(live == 2);
+		REQUIRE(pool.capacity() == 64 * 8);
+
+		// Emptying a whole chunk releases it
+		for (int i = 0; i < 256; ++i) {
+			pool.free(ptrs[i]);
+		}
+		pool.shrink();
+		REQUIRE(live == 1);
+		REQUIRE(pool.size() == 256);
+		for (int i = 256; i < 512; ++i) {
+			REQUIRE(pool.contains(ptrs[i]));
+			REQUIRE(*ptrs[i] == i);
+		}
+	}
+	SECTION("aligned") {
+		ez::BasicMemoryPool<std::unordered_map, int, 64, true, CountingSource> pool(CountingSource{ &live });
+		pool.set_growth(2, 16);
+		std::vector<int*> ptrs;
+		for (int i = 0; i < 64 * 30; ++i) {
+			ptrs.push_back(pool.create(i));
+		}
+		REQUIRE(live == 4);
+		for (int i = 0; i < 64 * 30; i += 2) {
+			pool.free(ptrs[i]);
+		}
+		REQUIRE(pool.size() == 64 * 15);
+		pool.clear();
+		REQUIRE(live == 0);
+	}
+	REQUIRE(live == 0);
+}
+
+template<typename Pool>
+static void exercisePool(Pool& pool) {
+	std::vector<int*> ptrs;
+	for (int i = 0; i < 10000; ++i) {
+		ptrs.push_back(pool.create(i));
+		REQUIRE(ptrs.back() != nullptr);
+	}
+	for (int i = 0; i < 10000; i += 2) {
+		pool.free(ptrs[i]);
+	}
+	pool.shrink();
+	for (int i = 0; i < 5000; ++i) {
+		ptrs[i * 2] = pool.create(i);
+	}
+	REQUIRE(pool.size() == 10000);
+
+	long long sum = 0;
+	for (int val : pool) {
+		sum += val;
+	}
+	// The odd values survive, the freed slots now hold 0 to 4999
+	REQUIRE(sum == 5000ll * 5000 + 5000ll * 4999 / 2);
+}
+
+TEST_CASE("mmap block source") {
+	SECTION("plain pages") {
+		ez::BasicMemoryPool<std::unordered_map, int, 256, false, ez::MmapBlockSource<>> pool;
+		exercisePool(pool);
+		REQUIRE(pool.get_source().mapped() >= std::size_t(1) << 20);
+	}
+	SECTION("aligned") {
+		ez::BasicMemoryPool<std::unordered_map, int, 256, true, ez::MmapBlockSource<64 * 1024>> pool;
+		exercisePool(pool);
+		REQUIRE(pool.capacity() >= 10000);
+	}
+	SECTION("huge pages") {
+		ez::BasicMemoryPool<std::unordered_map, int, 256, false, ez::HugePageBlockSource<>> pool;
+		exercisePool(pool);
+		REQUIRE(pool.get_source().mapped() % ez::intern::HugePageBytes == 0);
+	}
+	SECTION("chunked growth") {
+		ez::BasicMemoryPool<std::unordered_map, int, 64, false, ez::MmapBlockSource<>> pool;
+		pool.set_growth(1, 64);
+		exercisePool(pool);
+	}
+	SECTION("chunks after single blocks") {
+		// A single block released to the source must not come back as a chunk
+		ez::BasicMemoryPool<std::unordered_map, int, 64, false, ez::MmapBlockSource<>> pool;
+		int* first = pool.create(-1);
+		pool.free(first);
+		pool.trim(0);
+		int* kept = pool.create(-2);
+
+		pool.set_growth(16, 16);
+		std::vector<int*> ptrs;
+		for (int i = 0; i < 64 * 20; ++i) {
+			ptrs.push_back(pool.create(i));
+		}
+		REQUIRE(*kept == -2);
+		long long sum = 0;
+		for (int* ptr : ptrs) {
+			sum += *ptr;
+		}
+		REQUIRE(sum == 64ll * 20 * (64 * 20 - 1) / 2);
+		std::set<int*> unique(ptrs.begin(), ptrs.end());
+		unique.insert(kept);
+		REQUIRE(unique.size() == ptrs.size() + 1);
+	}
+	SECTION("huge pages with chunked growth") {
+		ez::BasicMemoryPool<std::unordered_map, int, 256, false, ez::HugePageBlockSource<>> pool;
+		pool.set_growth(2, 32);
+		exercisePool(pool);
+		pool.reserve(100000);
+		REQUIRE(pool.capacity() >= 100000);
+	}
+	SECTION("object pool move") {
+		ez::BasicObjectPool<std::unordered_map, std::string, 32, false, ez::MmapBlockSource<>> pool;
+		for (int i = 0; i < 100; ++i) {
+			pool.create(std::to_string(i));
+		}
+		auto other = std::move(pool);
+		REQUIRE(other.size() == 100);
+		REQUIRE(pool.size() == 0);
+
+		pool.create("reused");
+		REQUIRE(pool.size() == 1);
+	}
+}
+
+TEST_CASE("block recycler") {
+	using int_pool = ez::BasicMemoryPool<std::unordered_map, int, 64, false, ez::RecyclingBlockSource>;
+	using float_pool = ez::BasicMemoryPool<std::unordered_map, float, 64, false, ez::RecyclingBlockSource>;
+	// Types of the same size and alignment share the pool core, so their blocks have the same layout
+	static_assert(std::is_same_v<int_pool::core_type, float_pool::core_type>);
+
+	ez::BlockRecycler& recycler = ez::BlockRecycler::global();
+	recycler.release();
+	REQUIRE(recycler.cached() == 0);
+
+	{
+		int_pool ints;
+		ints.reserve(64 * 10);
+		REQUIRE(ints.capacity() == 64 * 10);
+	}
+	std::size_t blockBytes = recycler.cached() / 10;
+	REQUIRE(blockBytes > 0);
+	REQUIRE(recycler.cached() == blockBytes * 10);
+
+	// Another type takes the blocks left behind
+	float_pool floats;
+	floats.reserve(64 * 4);
+	REQUIRE(recycler.cached() == blockBytes * 6);
+	for (int i = 0; i < 64 * 4; ++i) {
+		*floats.alloc() = 1.f;
+	}
+
+	// Released blocks go back to the recycler
+	floats.clear();
+	REQUIRE(recycler.cached() == blockBytes * 10);
+
+	recycler.set_limit(blockBytes * 2);
+	REQUIRE(recycler.cached() == blockBytes * 2);
+	recycler.set_limit(ez::BlockRecycler::DefaultLimit);
+	recycler.release();
+}
@@ -0,0 +1,178 @@
+#include <catch2/catch_all.hpp>
+#include <ez/ConcurrentMemoryPool.hpp>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+TEST_CASE("concurrent pool single thread") {
+	ez::ConcurrentMemoryPool<int> pool;
+
+	REQUIRE(pool.empty());
+
+	std::vector<int*> ptrs;
+	for (int i = 0; i < 1000; ++i) {
+		ptrs.push_back(pool.create(i));
+	}
+	REQUIRE(pool.size() == 1000);
+	REQUIRE(pool.capacity() == 1024);
+
+	for (int i = 0; i < 1000; ++i) {
+		REQUIRE(*ptrs[i] == i);
+	}
+
+	for (int* ptr : ptrs) {
+		pool.destroy(ptr);
+	}
+	REQUIRE(pool.empty());
+
+	// Everything is cached by this thread until flushed
+	pool.flush();
+	pool.shrink();
+	REQUIRE(pool.capacity() == 0);
+}
+
+TEST_CASE("concurrent pool threads") {
+	ez::ConcurrentMemoryPool<std::size_t, 64, 16> pool;
+
+	constexpr std::size_t numThreads = 4;
+	constexpr std::size_t perThread = 5000;
+
+	std::atomic<std::size_t> failures{ 0 };
+	std::vector<std::thread> threads;
+	for (std::size_t t = 0; t < numThreads; ++t) {
+		threads.emplace_back([&, t]() {
+			std::vector<std::size_t*> ptrs;
+			for (int round = 0; round < 4; ++round) {
+				for (std::size_t i = 0; i < perThread; ++i) {
+					ptrs.push_back(pool.create(t * perThread + i));
+				}
+				for (std::size_t i = 0; i < perThread; ++i) {
+					if (*ptrs[i] != t * perThread + i) {
+						++failures;
+					}
+				}
+				for (std::size_t* ptr : ptrs) {
+					pool.destroy(ptr);
+				}
+				ptrs.clear();
+			}
+		});
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	REQUIRE(failures == 0);
+	REQUIRE(pool.empty());
+
+	// Exited threads returned their caches
+	pool.shrink();
+	REQUIRE(pool.capacity() == 0);
+}
+
+TEST_CASE("concurrent pool cross thread free") {
+	ez::ConcurrentMemoryPool<int, 64, 8> pool;
+
+	std::vector<int*> ptrs;
+	for (int i = 0; i < 4096; ++i) {
+		ptrs.push_back(pool.create(i));
+	}
+
+	// Free everything on other threads while this thread keeps allocating
+	std::thread a([&]() {
+		for (std::size_t i = 0; i < ptrs.size(); i += 2) {
+			pool.destroy(ptrs[i]);
+		}
+	});
+	std::thread b([&]() {
+		for (std::size_t i = 1; i < ptrs.size(); i += 2) {
+			pool.destroy(ptrs[i]);
+		}
+	});
+
+	std::vector<int*> more;
+	for (int i = 0; i < 4096; ++i) {
+		more.push_back(pool.create(i));
+	}
+	a.join();
+	b.join();
+
+	for (int i = 0; i < 4096; ++i) {
+		REQUIRE(*more[i] == i);
+	}
+	REQUIRE(pool.size() == 4096);
+
+	for (int* ptr : more) {
+		pool.destroy(ptr);
+	}
+	pool.flush();
+	REQUIRE(pool.empty());
+
+	pool.shrink();
+	REQUIRE(pool.capacity() == 0);
+}
+
+TEST_CASE("concurrent pool producer consumer") {
+	ez::ConcurrentMemoryPool<std::size_t, 128, 16> pool;
+
+	constexpr std::size_t numConsumers = 3;
+	constexpr std::size_t total = 30000;
+
+	// A single producer hands objects to the consumers, which destroy them
+	std::mutex queueMutex;
+	std::vector<std::size_t*> queue;
+	std::atomic<bool> done{ false };
+	std::atomic<std::size_t> consumed{ 0 }, sum{ 0 };
+
+	std::vector<std::thread> consumers;
+	for (std::size_t t = 0; t < numConsumers; ++t) {
+		consumers.emplace_back([&]() {
+			std::vector<std::size_t*> local;
+			while (true) {
+				{
+					std::lock_guard<std::mutex> lock(queueMutex);
+					local.swap(queue);
+				}
+				if (local.empty()) {
+					if (done) {
+						std::lock_guard<std::mutex> lock(queueMutex);
+						if (queue.empty()) {
+							break;
+						}
+					}
+					std::this_thread::yield();
+					continue;
+				}
+				for (std::size_t* ptr : local) {
+					sum += *ptr;
+					pool.destroy(ptr);
+				}
+				consumed += local.size();
+				local.clear();
+			}
+		});
+	}
+
+	for (std::size_t i = 0; i < total; ++i) {
+		std::size_t* ptr = pool.create(i);
+		std::lock_guard<std::mutex> lock(queueMutex);
+		queue.push_back(ptr);
+	}
+	done = true;
+	for (std::thread& thread : consumers) {
+		thread.join();
+	}
+
+	REQUIRE(consumed == total);
+	REQUIRE(sum == total * (total - 1) / 2);
+	REQUIRE(pool.empty());
+
+	// The producer reuses every slot freed by the consumers
+	std::ptrdiff_t capacity = pool.capacity();
+	for (std::ptrdiff_t i = 0; i < capacity; ++i) {
+		pool.create(static_cast<std::size_t>(i));
+	}
+	REQUIRE(pool.capacity() == capacity);
+	REQUIRE(pool.size() == capacity);
+}
@@ -0,0 +1,207 @@
+#include <catch2/catch_all.hpp>
+#if defined(EZ_POOL_HARDENED)
+#include <ez/MemoryPool.hpp>
+#include <ez/ObjectPool.hpp>
+#if !defined(_WIN32)
+#include <ez/PersistentPool.hpp>
+#include <cstdio>
+#include <filesystem>
+#endif
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+	std::vector<std::pair<ez::PoolViolation, const void*>> violations;
+
+	void recordViolation(ez::PoolViolation violation, const void* ptr) {
+		violations.emplace_back(violation, ptr);
+	}
+
+	// Records the violations instead of aborting while in scope
+	struct RecordViolations {
+		ez::PoolViolationHandler previous;
+
+		RecordViolations()
+			: previous(ez::set_violation_handler(&recordViolation))
+		{
+			violations.clear();
+		}
+		~RecordViolations() {
+			ez::set_violation_handler(previous);
+		}
+	};
+
+	struct Record {
+		int id;
+		float values[3];
+	};
+}
+
+TEST_CASE("hardened double free") {
+	RecordViolations scope;
+
+	SECTION("free") {
+		ez::MemoryPool<Record, 64> pool;
+		Record* a = pool.create(1);
+		Record* b = pool.create(2);
+		pool.free(a);
+		REQUIRE(violations.empty());
+
+		pool.free(a);
+		REQUIRE(violations.size() == 1);
+		REQUIRE(violations[0].first == ez::PoolViolation::DoubleFree);
+		REQUIRE(violations[0].second == a);
+		// The bad free is ignored
+		REQUIRE(pool.size() == 1);
+		REQUIRE(b->id == 2);
+	}
+	SECTION("free_n") {
+		ez::MemoryPool<Record, 64> pool;
+		std::vector<Record*> ptrs(100);
+		REQUIRE(pool.alloc_n(ptrs.data(), ptrs.size()) == 100);
+		pool.free(ptrs[10]);
+
+		pool.free_n(ptrs.data(), ptrs.size());
+		REQUIRE(violations.size() == 1);
+		REQUIRE(violations[0].first == ez::PoolViolation::DoubleFree);
+		REQUIRE(violations[0].second == ptrs[10]);
+		REQUIRE(pool.empty());
+	}
+	SECTION("destroy runs no destructor twice") {
+		// A second destructor call on a std::string would free its buffer twice
+		ez::ObjectPool<std::string, 64> pool;
+		std::string* a = pool.create(std::string(100, 'a'));
+		std::string* b = pool.create(std::string(100, 'b'));
+		pool.destroy(a);
+		pool.destroy(a);
+		REQUIRE(violations.size() == 1);
+		REQUIRE(violations[0].first == ez::PoolViolation::DoubleFree);
+		REQUIRE(violations[0].second == a);
+		REQUIRE(pool.size() == 1);
+		REQUIRE(*b == std::string(100, 'b'));
+	}
+	SECTION("destroy_n with a repeated pointer") {
+		ez::ObjectPool<std::string, 64> pool;
+		std::vector<std::string*> ptrs;
+		for (int i = 0; i < 10; ++i) {
+			ptrs.push_back(pool.create(std::string(100, 'x')));
+		}
+		ptrs.push_back(ptrs[3]);
+		pool.destroy_n(ptrs.data(), ptrs.size());
+		REQUIRE(violations.size() == 1);
+		REQUIRE(violations[0].first == ez::PoolViolation::DoubleFree);
+		REQUIRE(violations[0].second == ptrs[3]);
+		REQUIRE(pool.empty());
+	}
+	SECTION("object pool") {
+		ez::ObjectPool<Record, 64> pool;
+		Record* a = pool.create(1);
+		pool.destroy(a);
+		pool.destroy(a);
+		REQUIRE(violations.size() == 1);
+		REQUIRE(violations[0].first == ez::PoolViolation::DoubleFree);
+		REQUIRE(pool.size() == 0);
+	}
+}
+
+TEST_CASE("hardened foreign pointers") {
+	RecordViolations scope;
+
+	SECTION("unaligned pool") {
+		ez::MemoryPool<Record, 64> pool;
+		ez::MemoryPool<Record, 64> other;
+		Record* a = pool.create(1);
+		Record* b = other.create(2);
+		Record local{};
+
+		pool.free(&local);
+		pool.free(b);
+		// Points inside an object
+		pool.free(reinterpret_cast<Record*>(reinterpret_cast<char*>(a) + 4));
+
+		REQUIRE(violations.size() == 3);
+		for (auto& violation : violations) {
+			REQUIRE(violation.first == ez::PoolViolation::ForeignPointer);
+		}
+		REQUIRE(violations[0].second == &local);
+		REQUIRE(violations[1].second == b);
+		REQUIRE(pool.size() == 1);
+		REQUIRE(other.size() == 1);
+	}
+	SECTION("aligned pool") {
+		// Aligned pools normally find the block by masking, hardened builds check the map as well
+		ez::AlignedMemoryPool<Record, 64> pool;
+		ez::AlignedMemoryPool<Record, 64> other;
+		pool.create(1);
+		Record* b = other.create(2);
+
+		pool.free(b);
+		REQUIRE(violations.size() == 1);
+		REQUIRE(violations[0].first == ez::PoolViolation::ForeignPointer);
+		REQUIRE(pool.size() == 1);
+	}
+}
+
+TEST_CASE("hardened poisoning") {
+	RecordViolations scope;
+	ez::MemoryPool<Record, 64> pool;
+	Record* a = pool.create(1, 1.f, 2.f, 3.f);
+	pool.create(2);
+	pool.free(a);
+
+#if defined(EZ_POOL_ASAN)
+	// The free slot is hidden from AddressSanitizer until it is allocated again
+	REQUIRE(__asan_address_is_poisoned(&a->values[0]));
+	Record* again = pool.alloc();
+	REQUIRE(again == a);
+	REQUIRE(!__asan_address_is_poisoned(&again->values[0]));
+	REQUIRE(violations.empty());
+#else
+	// Everything past the free list index holds the poison pattern
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(a);
+	for (std::size_t i = 1; i < sizeof(Record); ++i) {
+		REQUIRE(bytes[i] == ez::intern::PoisonByte);
+	}
+
+	// A write through the dangling pointer is caught when the slot is handed out again
+	a->values[1] = 5.f;
+	Record* again = pool.alloc();
+	REQUIRE(again == a);
+	REQUIRE(violations.size() == 1);
+	REQUIRE(violations[0].first == ez::PoolViolation::UseAfterFree);
+	REQUIRE(violations[0].second == a);
+#endif
+
+	// Fresh and cleared blocks are poisoned too
+	std::size_t before = violations.size();
+	pool.clear();
+	for (int i = 0; i < 64 * 4; ++i) {
+		pool.create(i);
+	}
+	REQUIRE(violations.size() == before);
+}
+
+#if !defined(_WIN32)
+TEST_CASE("hardened persistent pool") {
+	RecordViolations scope;
+	std::string path = (std::filesystem::temp_directory_path() / "ez_pool_hardened_test.pool").string();
+	std::remove(path.c_str());
+	{
+		ez::PersistentPool<Record, 64> pool(path.c_str());
+		REQUIRE(pool.is_open());
+		Record* a = pool.create(1);
+		Record local{};
+
+		pool.free(a);
+		pool.free(a);
+		pool.free(&local);
+		REQUIRE(violations.size() == 2);
+		REQUIRE(violations[0].first == ez::PoolViolation::DoubleFree);
+		REQUIRE(violations[1].first == ez::PoolViolation::ForeignPointer);
+		REQUIRE(pool.empty());
+	}
+	std::remove(path.c_str());
+}
+#endif
+#endif
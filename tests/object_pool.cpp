@@ -3,6 +3,8 @@
 #include <fmt/printf.h>
 #include <ez/ObjectPool.hpp>
 #include <string>
+#include <vector>
+#include <unordered_map>
 
 TEST_CASE("object pools") {
 	using pool_t = ez::ObjectPool<std::string>;
@@ -20,4 +22,77 @@ TEST_CASE("object pools") {
 
 	fmt::print("Quick! Whats a good way to learn some programming?\n");
 	fmt::print("Doing a quick '{}' program of course.\n", *str);
-}
\ No newline at end of file
+}
+TEST_CASE("bulk object pools") {
+	ez::ObjectPool<std::string> pool;
+
+	std::vector<std::string*> ptrs(300);
+	REQUIRE(pool.create_n(ptrs.data(), ptrs.size(), "a fairly long string, to avoid the small string optimization") == 300);
+	REQUIRE(pool.size() == 300);
+	for (std::string* str : ptrs) {
+		REQUIRE(*str == "a fairly long string, to avoid the small string optimization");
+	}
+
+	pool.destroy_n(ptrs.data(), ptrs.size());
+	REQUIRE(pool.empty());
+}
+TEST_CASE("destroy_if object pools") {
+	ez::ObjectPool<std::string, 64> pool;
+	for (int i = 0; i < 64 * 8; ++i) {
+		pool.create(fmt::format("a long string to avoid the small string optimization {}", i));
+	}
+
+	std::size_t destroyed = pool.destroy_if([](const std::string& str) {
+		return str.back() == '7';
+	});
+	REQUIRE(destroyed == 51);
+	REQUIRE(pool.size() == 64 * 8 - 51);
+	for (const std::string& str : pool) {
+		REQUIRE(str.back() != '7');
+	}
+
+	// The free function form destroys as well
+	REQUIRE(ez::erase_if(pool, [](const std::string&) { return true; }) == 64 * 8 - 51);
+	REQUIRE(pool.empty());
+}
+TEST_CASE("compact object pools") {
+	ez::ObjectPool<std::string, 64> pool;
+
+	std::vector<std::string*> ptrs;
+	for (int i = 0; i < 64 * 20; ++i) {
+		ptrs.push_back(pool.create(fmt::format("a long string to avoid the small string optimization {}", i)));
+	}
+	// Leave every block about 10% occupied
+	std::unordered_map<const std::string*, int> live;
+	for (int i = 0; i < static_cast<int>(ptrs.size()); ++i) {
+		if (i % 10 == 0) {
+			live.insert({ ptrs[i], i });
+		}
+		else {
+			pool.destroy(ptrs[i]);
+		}
+	}
+	REQUIRE(pool.capacity() == 64 * 20);
+
+	std::size_t moved = pool.compact([&](const std::string* from, std::string* to) {
+		auto iter = live.find(from);
+		REQUIRE(iter != live.end());
+		int index = iter->second;
+		live.erase(iter);
+		live.insert({ to, index });
+	});
+	REQUIRE(moved > 0);
+	REQUIRE(pool.size() == 128);
+	REQUIRE(pool.capacity() == 128);
+
+	REQUIRE(live.size() == 128);
+	for (auto& entry : live) {
+		REQUIRE(pool.contains(entry.first));
+		REQUIRE(*entry.first == fmt::format("a long string to avoid the small string optimization {}", entry.second));
+	}
+
+	// The free list must still be usable
+	pool.create("after");
+	REQUIRE(pool.size() == 129);
+	REQUIRE(pool.capacity() == 192);
+}
@@ -0,0 +1,63 @@
+#include <catch2/catch_all.hpp>
+#include <ez/ObjectPool.hpp>
+#include <ez/ParallelForEach.hpp>
+#include <atomic>
+#include <vector>
+
+TEST_CASE("block ranges") {
+	ez::MemoryPool<int, 64> pool;
+
+	std::vector<int*> ptrs;
+	for (int i = 0; i < 640; ++i) {
+		ptrs.push_back(pool.create(i));
+	}
+	// Empty one block entirely
+	for (int i = 64; i < 128; ++i) {
+		pool.free(ptrs[i]);
+	}
+
+	auto range = pool.blocks();
+	REQUIRE(range.size() == 9);
+
+	std::size_t count = 0;
+	for (const auto& view : range) {
+		REQUIRE(view.size() == 64);
+		for (int val : view) {
+			REQUIRE((val < 64 || val >= 128));
+			++count;
+		}
+	}
+	REQUIRE(count == 576);
+}
+
+TEST_CASE("parallel for each") {
+	ez::ObjectPool<std::uint64_t, 64> pool;
+	for (std::uint64_t i = 0; i < 10000; ++i) {
+		pool.create(i);
+	}
+
+	SECTION("thread pool") {
+		ez::ThreadPool workers(3);
+		REQUIRE(workers.concurrency() == 4);
+
+		// Run twice, to reuse the workers
+		for (int round = 0; round < 2; ++round) {
+			ez::for_each(workers, pool, [](std::uint64_t& val) {
+				val *= 2;
+			});
+		}
+
+		std::atomic<std::uint64_t> sum{ 0 };
+		ez::for_each(workers, pool, [&](std::uint64_t val) {
+			sum += val;
+		});
+		REQUIRE(sum == 4 * (10000ull * 9999ull / 2));
+	}
+	SECTION("execution policy") {
+		std::uint64_t sum = 0;
+		ez::for_each(std::execution::seq, pool, [&](std::uint64_t& val) {
+			sum += val;
+		});
+		REQUIRE(sum == 10000ull * 9999ull / 2);
+	}
+}
@@ -0,0 +1,185 @@
+#include <catch2/catch_all.hpp>
+#if !defined(_WIN32)
+#include <ez/PersistentPool.hpp>
+#include <cstdio>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+	struct Record {
+		int id;
+		float value;
+	};
+
+	struct Node {
+		int value;
+		ez::OffsetPtr<Node> next;
+	};
+
+	std::string tempPath(const char* name) {
+		return (std::filesystem::temp_directory_path() / name).string();
+	}
+}
+
+template<>
+struct ez::is_persistable<Node> : std::true_type {};
+
+TEST_CASE("persistent pool") {
+	std::string path = tempPath("ez_pool_persistent_test.pool");
+	std::remove(path.c_str());
+
+	SECTION("reopen") {
+		{
+			ez::PersistentPool<Record, 64> pool(path.c_str());
+			REQUIRE(pool.is_open());
+			REQUIRE(pool.empty());
+
+			std::vector<Record*> ptrs;
+			for (int i = 0; i < 1000; ++i) {
+				ptrs.push_back(pool.create(i, float(i) * 0.5f));
+				REQUIRE(ptrs.back() != nullptr);
+			}
+			// Free every third record, leaving holes in the free lists
+			for (int i = 0; i < 1000; i += 3) {
+				pool.destroy(ptrs[i]);
+			}
+			REQUIRE(pool.flush());
+		}
+
+		ez::PersistentPool<Record, 64> pool(path.c_str());
+		REQUIRE(pool.is_open());
+		REQUIRE(pool.size() == 666);
+		REQUIRE(pool.capacity() >= 1000);
+
+		std::vector<bool> seen(1000, false);
+		for (const Record& record : pool) {
+			REQUIRE(record.id % 3 != 0);
+			REQUIRE(record.value == float(record.id) * 0.5f);
+			REQUIRE(!seen[record.id]);
+			seen[record.id] = true;
+		}
+		for (int i = 0; i < 1000; ++i) {
+			REQUIRE(seen[i] == (i % 3 != 0));
+		}
+
+		// The freed slots are reused before the file grows
+		std::ptrdiff_t capacity = pool.capacity();
+		for (int i = 0; i < 334; ++i) {
+			Record* record = pool.create(-1, 0.f);
+			REQUIRE(pool.contains(record));
+		}
+		REQUIRE(pool.size() == 1000);
+		REQUIRE(pool.capacity() == capacity);
+
+		// Objects can be freed after a reopen
+		std::vector<Record*> live;
+		for (Record& record : pool) {
+			live.push_back(&record);
+		}
+		for (Record* record : live) {
+			pool.free(record);
+		}
+		REQUIRE(pool.empty());
+		REQUIRE(pool.begin() == pool.end());
+	}
+
+	SECTION("growth keeps addresses") {
+		ez::PersistentPool<Record, 16> pool(path.c_str());
+		REQUIRE(pool.is_open());
+
+		std::vector<Record*> ptrs;
+		for (int i = 0; i < 5000; ++i) {
+			ptrs.push_back(pool.create(i, 0.f));
+		}
+		for (int i = 0; i < 5000; ++i) {
+			REQUIRE(ptrs[i]->id == i);
+			REQUIRE(pool.contains(ptrs[i]));
+		}
+
+		Record outside{};
+		REQUIRE(!pool.contains(&outside));
+
+		REQUIRE(pool.reserve(10000));
+		REQUIRE(pool.capacity() >= 10000);
+		REQUIRE(ptrs[0]->id == 0);
+	}
+
+	SECTION("address space limit") {
+		ez::PersistentPool<Record, 16> pool(path.c_str(), 1 << 16);
+		REQUIRE(pool.is_open());
+
+		std::size_t made = 0;
+		while (pool.alloc() != nullptr) {
+			++made;
+		}
+		REQUIRE(made > 0);
+		REQUIRE(pool.file_size() <= pool.max_bytes());
+		REQUIRE(static_cast<std::ptrdiff_t>(made) == pool.capacity());
+	}
+
+	SECTION("layout mismatch") {
+		{
+			ez::PersistentPool<Record, 64> pool(path.c_str());
+			REQUIRE(pool.is_open());
+			pool.create(1, 1.f);
+		}
+		ez::PersistentPool<Record, 32> other(path.c_str());
+		REQUIRE(!other.is_open());
+		ez::PersistentPool<double, 64> wrong(path.c_str());
+		REQUIRE(!wrong.is_open());
+
+		{
+			ez::PersistentPool<Record, 64> same(path.c_str());
+			REQUIRE(same.is_open());
+			REQUIRE(same.size() == 1);
+		}
+
+		// A block count far past the end of the file, large enough to wrap when multiplied by the block size
+		std::FILE* file = std::fopen(path.c_str(), "r+b");
+		REQUIRE(file != nullptr);
+		// The count is the last header field: magic, version and data offset, then four 64 bit layout fields
+		std::uint64_t blocks = std::uint64_t(1) << 62;
+		REQUIRE(std::fseek(file, 48, SEEK_SET) == 0);
+		REQUIRE(std::fwrite(&blocks, sizeof(blocks), 1, file) == 1);
+		std::fclose(file);
+
+		ez::PersistentPool<Record, 64> corrupt(path.c_str());
+		REQUIRE(!corrupt.is_open());
+	}
+
+	SECTION("offset pointers") {
+		{
+			ez::PersistentPool<Node> pool(path.c_str());
+			Node* head = nullptr;
+			for (int i = 0; i < 100; ++i) {
+				Node* node = pool.alloc();
+				node->value = i;
+				new (&node->next) ez::OffsetPtr<Node>(head);
+				head = node;
+			}
+		}
+
+		// The mapping usually lands at another address, the links still hold
+		ez::PersistentPool<Node> pool(path.c_str());
+		REQUIRE(pool.size() == 100);
+		const Node* head = nullptr;
+		for (const Node& node : pool) {
+			if (node.value == 99) {
+				head = &node;
+			}
+		}
+		REQUIRE(head != nullptr);
+
+		int expected = 99;
+		for (const Node* node = head; node != nullptr; node = node->next.get()) {
+			REQUIRE(node->value == expected);
+			--expected;
+		}
+		REQUIRE(expected == -1);
+	}
+
+	std::remove(path.c_str());
+}
+#endif
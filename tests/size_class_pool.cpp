@@ -0,0 +1,78 @@
+#include <catch2/catch_all.hpp>
+#include <ez/SizeClassPool.hpp>
+#include <cstring>
+#include <string>
+#include <vector>
+
+TEST_CASE("size class pool") {
+	ez::SizeClassPool<> pool;
+	using pool_t = ez::SizeClassPool<>;
+
+	SECTION("class selection") {
+		REQUIRE(pool_t::size_class(0, 1) == 0);
+		REQUIRE(pool_t::class_size(pool_t::size_class(1)) == 16);
+		REQUIRE(pool_t::class_size(pool_t::size_class(1, 8)) == 8);
+		REQUIRE(pool_t::class_size(pool_t::size_class(17, 8)) == 24);
+		REQUIRE(pool_t::class_size(pool_t::size_class(17, 16)) == 32);
+		REQUIRE(pool_t::class_size(pool_t::size_class(129)) == 160);
+		REQUIRE(pool_t::class_size(pool_t::size_class(1024)) == 1024);
+		REQUIRE(pool_t::size_class(1025) == pool_t::NumClasses);
+		REQUIRE(pool_t::size_class(8, 64) == pool_t::NumClasses);
+
+		for (std::size_t bytes = 1; bytes <= pool_t::MaxSize; ++bytes) {
+			std::size_t index = pool_t::size_class(bytes, 8);
+			REQUIRE(pool_t::class_size(index) >= bytes);
+			REQUIRE((index == 0 || pool_t::class_size(index - 1) < bytes));
+		}
+	}
+	SECTION("allocations") {
+		struct Alloc {
+			void* ptr;
+			std::size_t bytes;
+		};
+		std::vector<Alloc> allocs;
+		for (std::size_t i = 0; i < 4000; ++i) {
+			std::size_t bytes = 1 + (i * 37) % 1500;
+			void* ptr = pool.allocate(bytes);
+			REQUIRE(reinterpret_cast<std::uintptr_t>(ptr) % alignof(std::max_align_t) == 0);
+			std::memset(ptr, static_cast<int>(i & 0xFF), bytes);
+			allocs.push_back(Alloc{ ptr, bytes });
+
+			REQUIRE(pool.contains(ptr) == (bytes <= pool_t::MaxSize));
+		}
+		std::size_t small = 0;
+		for (const Alloc& alloc : allocs) {
+			small += alloc.bytes <= pool_t::MaxSize;
+		}
+		REQUIRE(pool.size() == small);
+
+		for (std::size_t i = 0; i < allocs.size(); ++i) {
+			const unsigned char* bytes = static_cast<const unsigned char*>(allocs[i].ptr);
+			REQUIRE(bytes[0] == (i & 0xFF));
+			REQUIRE(bytes[allocs[i].bytes - 1] == (i & 0xFF));
+		}
+
+		// Each class is an ordinary pool
+		REQUIRE(pool.class_pool<0>().size() == 0);
+		REQUIRE(pool.class_pool<1>().size() > 0);
+		for (const auto& slot : pool.class_pool<1>()) {
+			REQUIRE(pool.contains(&slot));
+		}
+
+		for (const Alloc& alloc : allocs) {
+			pool.deallocate(alloc.ptr, alloc.bytes);
+		}
+		REQUIRE(pool.size() == 0);
+		pool.shrink();
+		REQUIRE(pool.class_pool<1>().capacity() == 0);
+	}
+	SECTION("pmr containers") {
+		std::pmr::vector<std::pmr::string> strings(&pool);
+		for (int i = 0; i < 100; ++i) {
+			strings.emplace_back(std::string(static_cast<std::size_t>(i) * 3, 'x'));
+		}
+		for (int i = 0; i < 100; ++i) {
+			REQUIRE(strings[i].size() == static_cast<std::size_t>(i) * 3);
+		}
+	}
+}
@@ -0,0 +1,153 @@
+#include <catch2/catch_all.hpp>
+#include <ez/SlotPool.hpp>
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+namespace {
+	// Forwards to operator new until the budget of blocks runs out, then fails
+	struct LimitedSource {
+		int* budget;
+
+		explicit LimitedSource(int* _budget = nullptr)
+			: budget(_budget)
+		{}
+
+		void* allocate(std::size_t bytes, std::size_t align) noexcept {
+			if (*budget == 0) {
+				return nullptr;
+			}
+			--*budget;
+			return ez::NewBlockSource{}.allocate(bytes, align);
+		}
+		void deallocate(void* ptr, std::size_t bytes, std::size_t align) noexcept {
+			ez::NewBlockSource{}.deallocate(ptr, bytes, align);
+		}
+	};
+}
+
+TEST_CASE("slot pool") {
+	ez::SlotPool<std::string, 64> pool;
+	using handle_t = ez::SlotPool<std::string, 64>::handle_type;
+
+	REQUIRE(pool.get(handle_t{}) == nullptr);
+
+	std::vector<handle_t> handles;
+	for (int i = 0; i < 1000; ++i) {
+		handles.push_back(pool.create(std::to_string(i)));
+		REQUIRE(handles.back());
+	}
+	REQUIRE(pool.size() == 1000);
+	for (int i = 0; i < 1000; ++i) {
+		REQUIRE(*pool.get(handles[i]) == std::to_string(i));
+	}
+
+	// Handles are unique
+	std::unordered_set<handle_t> unique(handles.begin(), handles.end());
+	REQUIRE(unique.size() == 1000);
+
+	SECTION("stale handles") {
+		for (int i = 0; i < 1000; i += 2) {
+			pool.destroy(handles[i]);
+		}
+		REQUIRE(pool.size() == 500);
+
+		// Reuse the freed slots
+		std::vector<handle_t> fresh;
+		for (int i = 0; i < 500; ++i) {
+			fresh.push_back(pool.create("fresh"));
+		}
+		for (int i = 0; i < 1000; ++i) {
+			if (i % 2 == 0) {
+				REQUIRE(!pool.contains(handles[i]));
+			}
+			else {
+				REQUIRE(*pool.get(handles[i]) == std::to_string(i));
+			}
+		}
+		for (handle_t handle : fresh) {
+			REQUIRE(*pool.get(handle) == "fresh");
+		}
+	}
+	SECTION("destroying stale handles") {
+		REQUIRE(pool.destroy(handles[0]));
+		REQUIRE(!pool.destroy(handles[0]));
+		REQUIRE(!pool.destroy(handle_t{}));
+		REQUIRE(pool.size() == 999);
+
+		// The failed destroy left the slot free, so the new object's handle differs from the stale one
+		handle_t handle = pool.create("again");
+		REQUIRE(*pool.get(handle) == "again");
+		REQUIRE(!pool.contains(handles[0]));
+		REQUIRE(!pool.destroy(handles[0]));
+		REQUIRE(pool.size() == 1000);
+	}
+	SECTION("shrink keeps generations") {
+		for (handle_t handle : handles) {
+			pool.destroy(handle);
+		}
+		pool.shrink();
+		REQUIRE(pool.capacity() == 0);
+
+		handle_t handle = pool.create("again");
+		REQUIRE(*pool.get(handle) == "again");
+		for (handle_t old : handles) {
+			REQUIRE(!pool.contains(old));
+		}
+	}
+	SECTION("iteration") {
+		std::size_t count = 0;
+		for (auto iter = pool.begin(); iter != pool.end(); ++iter) {
+			REQUIRE(pool.get(iter.handle()) == &*iter);
+			++count;
+		}
+		REQUIRE(count == 1000);
+	}
+	SECTION("clear") {
+		pool.clear();
+		REQUIRE(pool.empty());
+		REQUIRE(pool.capacity() == 1024);
+		REQUIRE(!pool.contains(handles[0]));
+	}
+}
+
+TEST_CASE("small slot handles") {
+	using pool_t = ez::SlotPool<int, 256, std::uint32_t>;
+	pool_t pool;
+	static_assert(sizeof(pool_t::handle_type) == 4);
+
+	pool_t::handle_type handle = pool.create(1);
+	REQUIRE(*pool.get(handle) == 1);
+
+	// Wrapping the generation counter takes 2^11 reuses of a slot
+	pool.destroy(handle);
+	for (int i = 0; i < 100; ++i) {
+		pool_t::handle_type next = pool.create(i);
+		REQUIRE(!pool.contains(handle));
+		pool.destroy(next);
+	}
+
+	pool_t moved = std::move(pool);
+	REQUIRE(moved.capacity() == 256);
+	REQUIRE(pool.capacity() == 0);
+}
+
+TEST_CASE("slot pool allocation failure") {
+	int budget = 2;
+	ez::SlotPool<int, 64, std::uint64_t, LimitedSource> pool(LimitedSource{ &budget });
+
+	for (int i = 0; i < 128; ++i) {
+		REQUIRE(pool.create(i));
+	}
+	// Failed block allocations leave the capacity as it was
+	for (int i = 0; i < 10; ++i) {
+		REQUIRE(!pool.create(i));
+	}
+	pool.reserve(1024);
+	REQUIRE(pool.capacity() == 128);
+	REQUIRE(pool.size() == 128);
+
+	budget = 1;
+	REQUIRE(pool.create(128));
+	REQUIRE(pool.capacity() == 192);
+}
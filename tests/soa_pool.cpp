@@ -0,0 +1,107 @@
+#include <catch2/catch_all.hpp>
+#include <ez/SoAPool.hpp>
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+	struct Vec2 {
+		float x, y;
+	};
+}
+
+TEST_CASE("soa pool") {
+	using pool_t = ez::BasicSoAPool<64, ez::NewBlockSource, Vec2, Vec2, std::uint32_t>;
+	pool_t pool;
+
+	std::vector<pool_t::row> rows;
+	for (int i = 0; i < 1000; ++i) {
+		float f = static_cast<float>(i);
+		rows.push_back(pool.create(Vec2{ f, f }, Vec2{ 1.f, 2.f }, static_cast<std::uint32_t>(i)));
+		REQUIRE(rows.back());
+	}
+	REQUIRE(pool.size() == 1000);
+	REQUIRE(pool.capacity() == 64 * 16);
+	for (int i = 0; i < 1000; ++i) {
+		REQUIRE(rows[i].get<0>().x == static_cast<float>(i));
+		REQUIRE(rows[i].get<2>() == static_cast<std::uint32_t>(i));
+	}
+
+	for (int i = 0; i < 1000; i += 3) {
+		pool.destroy(rows[i]);
+	}
+	REQUIRE(pool.size() == 666);
+
+	SECTION("block kernels") {
+		// Integrate the positions block by block, over whole arrays
+		pool_t::block_range blocks = pool.blocks();
+		std::size_t live = 0;
+		for (const pool_t::block_view& view : blocks) {
+			Vec2* pos = view.field<0>();
+			const Vec2* vel = view.field<1>();
+			for (std::size_t i = 0; i < view.max_size(); ++i) {
+				pos[i].x += vel[i].x;
+				pos[i].y += vel[i].y;
+			}
+
+			std::size_t bits = 0;
+			for (std::uint64_t word : view.mask()) {
+				bits += std::bitset<64>(word).count();
+			}
+			REQUIRE(bits == view.size());
+			live += view.size();
+		}
+		REQUIRE(live == 666);
+
+		for (int i = 0; i < 1000; ++i) {
+			if (i % 3 != 0) {
+				REQUIRE(rows[i].get<0>().x == static_cast<float>(i) + 1.f);
+				REQUIRE(rows[i].get<0>().y == static_cast<float>(i) + 2.f);
+			}
+		}
+	}
+	SECTION("iteration") {
+		std::uint64_t sum = 0, expected = 0;
+		for (pool_t::row row : pool) {
+			sum += row.get<2>();
+		}
+		for (int i = 0; i < 1000; ++i) {
+			if (i % 3 != 0) {
+				expected += static_cast<std::uint64_t>(i);
+			}
+		}
+		REQUIRE(sum == expected);
+	}
+	SECTION("reuse and shrink") {
+		// Freed slots are reused before any new block is created
+		for (int i = 0; i < 334; ++i) {
+			REQUIRE(pool.create());
+		}
+		REQUIRE(pool.capacity() == 64 * 16);
+
+		pool.clear();
+		REQUIRE(pool.empty());
+		REQUIRE(pool.blocks().empty());
+		pool.shrink();
+		REQUIRE(pool.capacity() == 0);
+	}
+}
+
+TEST_CASE("soa pool with non trivial fields") {
+	ez::SoAPool<std::string, int> pool;
+
+	auto first = pool.create(std::string("a string long enough to need a heap allocation"), 1);
+	auto second = pool.create();
+	REQUIRE(second.get<0>().empty());
+	REQUIRE(second.get<1>() == 0);
+
+	ez::SoAPool<std::string, int> moved = std::move(pool);
+	REQUIRE(pool.empty());
+	REQUIRE(moved.size() == 2);
+	REQUIRE(first.get<0>() == "a string long enough to need a heap allocation");
+
+	moved.destroy(first);
+	REQUIRE(moved.size() == 1);
+	REQUIRE((*moved.begin()) == second);
+}